@@ -8,8 +8,16 @@ const char INDEX_HTML[] PROGMEM = R"=====(
     <meta charset="UTF-8">
     <meta name="viewport" content="width=device-width, initial-scale=1.0">
     <title>ESP Control | GPIO2</title>
-    <link href="https://fonts.googleapis.com/css2?family=Outfit:wght@300;400;600;800&display=swap" rel="stylesheet">
     <style>
+        /* Served by the device (embed_html.py); no internet needed. Until
+           it loads, or if the build has none, the system font is used. */
+        @font-face {
+            font-family: 'Outfit';
+            src: url('/outfit.woff2') format('woff2');
+            font-weight: 300 800;
+            font-display: swap;
+        }
+
         :root {
             --primary: #00f2fe;
             --secondary: #4facfe;
@@ -22,7 +30,7 @@ const char INDEX_HTML[] PROGMEM = R"=====(
             margin: 0;
             padding: 0;
             box-sizing: border-box;
-            font-family: 'Outfit', sans-serif;
+            font-family: 'Outfit', system-ui, -apple-system, 'Segoe UI', Roboto, sans-serif;
         }
 
         body {
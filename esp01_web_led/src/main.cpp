@@ -2,6 +2,12 @@
 #include <ESP8266WebServer.h>
 #include <ArduinoJson.h>
 #include "index_html.h"
+#if __has_include("index_html_gz.h")
+#include "index_html_gz.h"
+#endif
+#if __has_include("font_woff2.h")
+#include "font_woff2.h"
+#endif
 
 // WiFi Credentials
 const char* ssid = "roku";
@@ -10,10 +16,44 @@ const char* password = "Linux.456";
 ESP8266WebServer server(80);
 const int ledPin = 2; // GPIO2
 
+// The page gzipped when the build generated it (embed_html.py) and the
+// browser accepts it; INDEX_HTML as is otherwise. Browsers keep it but
+// revalidate each load; an unchanged page costs a bare 304.
 void handleRoot() {
+#ifdef INDEX_HTML_GZ_H
+  bool gzip = server.header("Accept-Encoding").indexOf("gzip") >= 0;
+  const char *etag = gzip ? INDEX_HTML_GZ_ETAG : INDEX_HTML_ETAG;
+  server.sendHeader("Vary", "Accept-Encoding");
+  server.sendHeader("Cache-Control", "no-cache"); // Changes with the firmware, not on a schedule
+  server.sendHeader("ETag", etag);
+  if (server.header("If-None-Match").indexOf(etag) >= 0) {
+    server.send(304);
+    return;
+  }
+  if (gzip) {
+    server.sendHeader("Content-Encoding", "gzip");
+    server.send_P(200, "text/html", (PGM_P)INDEX_HTML_GZ, INDEX_HTML_GZ_LEN);
+    return;
+  }
+#endif
   server.send_P(200, "text/html", INDEX_HTML);
 }
 
+#ifdef FONT_WOFF2_H
+// Dashboard font, subsetted by embed_html.py when platformio.ini sets
+// custom_embed_font. woff2 is compressed already, so no gzip; cached for a
+// week, then revalidated.
+void handleFont() {
+  server.sendHeader("Cache-Control", "max-age=604800");
+  server.sendHeader("ETag", FONT_WOFF2_ETAG);
+  if (server.header("If-None-Match").indexOf(FONT_WOFF2_ETAG) >= 0) {
+    server.send(304);
+    return;
+  }
+  server.send_P(200, "font/woff2", (PGM_P)FONT_WOFF2, FONT_WOFF2_LEN);
+}
+#endif
+
 void handleToggle() {
   if (server.hasArg("state")) {
     int state = server.arg("state").toInt();
@@ -71,7 +111,12 @@ void setup() {
     Serial.println("\n[WIFI] Failed to connect.");
   }
 
+  static const char *headerKeys[] = {"Accept-Encoding", "If-None-Match"};
+  server.collectHeaders(headerKeys, 2);
   server.on("/", HTTP_GET, handleRoot);
+#ifdef FONT_WOFF2_H
+  server.on("/outfit.woff2", HTTP_GET, handleFont);
+#endif
   server.on("/toggle", HTTP_POST, handleToggle);
   server.on("/status", HTTP_GET, handleStatus);
   server.begin();
@@ -0,0 +1,32 @@
+// libFuzzer harness for the command parser, seeded from corpus/ (the same
+// seeds test_command_parser mutates on every `pio test -e native`). Not a
+// PlatformIO test suite; build and run it on the host with clang:
+//
+//   clang++ -g -O1 -fsanitize=fuzzer,address -I ../../../lib/flow_core fuzz_command_parser.cpp -o fuzz_command_parser
+//   ./fuzz_command_parser -max_len=256 corpus/
+//
+// New inputs that reach more code are written back to corpus/; commit the
+// interesting ones.
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "flow_commands.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    const char *payload = (const char *)data;
+    TextSpan frame(payload, size);
+    CommandLine line;
+    while (nextCommandLine(frame, line)) {
+        if (line.text.p < payload || line.text.p + line.text.len > payload + size) abort();
+        if (line.badId) continue;
+        ParsedCommand cmd;
+        if (parseCommand(COMMANDS, line.text, cmd) != PARSE_OK) continue;
+        for (uint8_t a = 0; a < COMMAND_MAX_ARGS && cmd.spec->args[a].type != ARG_NONE; a++) {
+            const ArgSpec &spec = cmd.spec->args[a];
+            const CommandArg &arg = cmd.args[a];
+            if (spec.type == ARG_INT && (arg.i < spec.min || arg.i > spec.max)) abort();
+            if (spec.type == ARG_FLOAT && !(arg.f >= spec.min && arg.f <= spec.max)) abort();
+        }
+    }
+    return 0;
+}
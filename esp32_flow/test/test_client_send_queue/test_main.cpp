@@ -0,0 +1,164 @@
+// ClientSendQueues drop policy and draining: a full queue supersedes its
+// oldest status message but never a control message, one client's backlog
+// leaves the others alone, and a drain that stops when the socket is full
+// picks up at the same message on the next pass, in order.
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "client_send_queue.h"
+
+#define CLIENTS 3
+#define DEPTH 4
+#define SIZE 32
+
+typedef ClientSendQueues<CLIENTS, DEPTH, SIZE> Queues;
+static Queues queues;
+
+static bool push(uint8_t num, const char *text, SendClass cls, uint32_t nowMs = 0) {
+    return queues.push(num, text, strlen(text), false, cls, nowMs);
+}
+
+// The front message as text, or "" when the queue is empty
+static const char *front(uint8_t num) {
+    static char text[SIZE + 1];
+    const Queues::Message *m = queues.front(num);
+    if (!m) return "";
+    memcpy(text, m->data, m->len);
+    text[m->len] = 0;
+    return text;
+}
+
+// flushClients() against a socket that takes `room` messages per pass
+static uint8_t drain(uint8_t num, uint8_t room, uint32_t nowMs, char (*out)[SIZE + 1] = nullptr) {
+    uint8_t written = 0;
+    for (const Queues::Message *m = queues.front(num); m && written < room; m = queues.front(num)) {
+        if (out) snprintf(out[written], SIZE + 1, "%.*s", (int)m->len, (const char *)m->data);
+        queues.sent(num, 10, nowMs);
+        written++;
+    }
+    return written;
+}
+
+void setUp() {
+    for (uint8_t num = 0; num < CLIENTS; num++) queues.clear(num);
+}
+void tearDown() {}
+
+void test_full_queue_supersedes_oldest_status() {
+    TEST_ASSERT_TRUE(push(0, "s1", SEND_STATUS));
+    TEST_ASSERT_TRUE(push(0, "c1", SEND_CONTROL));
+    TEST_ASSERT_TRUE(push(0, "s2", SEND_STATUS));
+    TEST_ASSERT_TRUE(push(0, "c2", SEND_CONTROL));
+    TEST_ASSERT_TRUE(push(0, "s3", SEND_STATUS)); // Drops s1
+    TEST_ASSERT_TRUE(push(0, "c3", SEND_CONTROL)); // Drops s2
+    TEST_ASSERT_EQUAL_UINT32(2, queues.stats(0).dropped);
+
+    char out[DEPTH][SIZE + 1];
+    TEST_ASSERT_EQUAL_UINT8(DEPTH, drain(0, DEPTH, 0, out));
+    TEST_ASSERT_EQUAL_STRING("c1", out[0]);
+    TEST_ASSERT_EQUAL_STRING("c2", out[1]);
+    TEST_ASSERT_EQUAL_STRING("s3", out[2]);
+    TEST_ASSERT_EQUAL_STRING("c3", out[3]);
+}
+
+// Control is never dropped: with nothing else queued, the push fails and
+// the sketch disconnects the client; a new status is dropped instead
+void test_control_never_dropped() {
+    for (uint8_t i = 0; i < DEPTH; i++) TEST_ASSERT_TRUE(push(0, "ack", SEND_CONTROL));
+    TEST_ASSERT_FALSE(push(0, "ack", SEND_CONTROL));
+    TEST_ASSERT_TRUE(push(0, "status", SEND_STATUS));
+    TEST_ASSERT_EQUAL_UINT8(DEPTH, queues.depth(0));
+    TEST_ASSERT_EQUAL_UINT32(1, queues.stats(0).dropped);
+    char out[DEPTH][SIZE + 1];
+    drain(0, DEPTH, 0, out);
+    for (uint8_t i = 0; i < DEPTH; i++) TEST_ASSERT_EQUAL_STRING("ack", out[i]);
+}
+
+void test_rejects_oversize_and_bad_client() {
+    char big[SIZE + 1];
+    memset(big, 'x', sizeof(big));
+    TEST_ASSERT_FALSE(queues.push(0, big, SIZE + 1, false, SEND_STATUS, 0));
+    TEST_ASSERT_TRUE(queues.push(0, big, SIZE, true, SEND_STATUS, 0));
+    TEST_ASSERT_TRUE(queues.front(0)->binary);
+    TEST_ASSERT_FALSE(push(CLIENTS, "s", SEND_STATUS));
+}
+
+// A stalled client fills and drops its own queue; the others are untouched
+void test_clients_are_isolated() {
+    for (uint8_t i = 0; i < 50; i++) {
+        char text[8];
+        snprintf(text, sizeof(text), "s%u", i);
+        TEST_ASSERT_TRUE(push(0, text, SEND_STATUS)); // Client 0 never drains
+        TEST_ASSERT_TRUE(push(1, text, SEND_STATUS));
+        TEST_ASSERT_EQUAL_UINT8(1, drain(1, 1, i));
+    }
+    TEST_ASSERT_EQUAL_UINT8(DEPTH, queues.depth(0));
+    TEST_ASSERT_EQUAL_UINT32(50 - DEPTH, queues.stats(0).dropped);
+    TEST_ASSERT_EQUAL_STRING("s46", front(0)); // The newest DEPTH survive
+    TEST_ASSERT_EQUAL_UINT32(0, queues.stats(1).dropped);
+    TEST_ASSERT_EQUAL_UINT32(50, queues.stats(1).sent);
+    TEST_ASSERT_EQUAL_UINT8(0, queues.depth(2));
+
+    queues.clear(0); // Disconnect: the slot starts over
+    TEST_ASSERT_EQUAL_UINT8(0, queues.depth(0));
+    TEST_ASSERT_EQUAL_UINT32(0, queues.stats(0).dropped);
+    TEST_ASSERT_EQUAL_UINT32(50, queues.stats(1).sent);
+}
+
+// The socket takes one message per pass: each pass resumes at the message
+// the last one could not write, nothing is skipped or repeated, and the
+// wait and depth statistics follow
+void test_drain_resumes_where_it_stopped() {
+    TEST_ASSERT_TRUE(push(0, "c1", SEND_CONTROL, 100));
+    TEST_ASSERT_TRUE(push(0, "c2", SEND_CONTROL, 110));
+    TEST_ASSERT_TRUE(push(0, "c3", SEND_CONTROL, 120));
+    TEST_ASSERT_EQUAL_STRING("c1", front(0));
+    TEST_ASSERT_EQUAL_UINT8(0, drain(0, 0, 130)); // Socket full: nothing written
+    TEST_ASSERT_EQUAL_STRING("c1", front(0));
+
+    char out[1][SIZE + 1];
+    TEST_ASSERT_EQUAL_UINT8(1, drain(0, 1, 150, out));
+    TEST_ASSERT_EQUAL_STRING("c1", out[0]);
+    TEST_ASSERT_TRUE(push(0, "c4", SEND_CONTROL, 155)); // Arrives mid-drain
+    const char *expect[] = {"c2", "c3", "c4"};
+    for (uint8_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT8(1, drain(0, 1, 200 + i, out));
+        TEST_ASSERT_EQUAL_STRING(expect[i], out[0]);
+    }
+    TEST_ASSERT_NULL(queues.front(0));
+    TEST_ASSERT_EQUAL_UINT32(4, queues.stats(0).sent);
+    TEST_ASSERT_EQUAL_UINT32(90, queues.stats(0).waitMsMax); // c2: queued 110, written 200
+    TEST_ASSERT_EQUAL_UINT8(3, queues.stats(0).maxDepth);
+
+    queues.resetPeaks(0);
+    TEST_ASSERT_EQUAL_UINT32(0, queues.stats(0).waitMsMax);
+    TEST_ASSERT_EQUAL_UINT8(0, queues.stats(0).maxDepth);
+    TEST_ASSERT_EQUAL_UINT32(4, queues.stats(0).sent);
+}
+
+// Slots cycle through the free list many times without losing any
+void test_slots_recycle() {
+    char text[8];
+    for (uint32_t i = 0; i < 1000; i++) {
+        snprintf(text, sizeof(text), "m%u", (unsigned)i);
+        TEST_ASSERT_TRUE(push(2, text, (i % 3) ? SEND_STATUS : SEND_CONTROL));
+        if (i % 2) {
+            drain(2, 1, i);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8(DEPTH - 1, queues.depth(2)); // The last pass sent one
+    TEST_ASSERT_EQUAL_UINT8(DEPTH - 1, drain(2, DEPTH, 1000));
+    TEST_ASSERT_NULL(queues.front(2));
+    TEST_ASSERT_EQUAL_UINT32(1000, queues.stats(2).sent + queues.stats(2).dropped);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_queue_supersedes_oldest_status);
+    RUN_TEST(test_control_never_dropped);
+    RUN_TEST(test_rejects_oversize_and_bad_client);
+    RUN_TEST(test_clients_are_isolated);
+    RUN_TEST(test_drain_resumes_where_it_stopped);
+    RUN_TEST(test_slots_recycle);
+    return UNITY_END();
+}
@@ -0,0 +1,153 @@
+// ClientSubscriptions with the sketch's topics: rate parsing and clamping,
+// the default set for clients that never subscribe, per-client gating in
+// due(), coalescing of updates faster than a client's rate, and
+// unsubscribe.
+#include <unity.h>
+#include "client_subscriptions.h"
+
+#define CLIENTS 4
+
+// The single-channel topics from src/main.cpp
+enum Topic : uint8_t { TOPIC_STATUS, TOPIC_SCOPE, TOPIC_COUNT };
+static const TopicInfo TOPICS[TOPIC_COUNT] = {
+    {"status", 200, 50}, // 5 Hz default, 20 Hz at most
+    {"scope", 0, 1},     // Opt-in
+};
+
+static ClientSubscriptions<CLIENTS, TOPIC_COUNT> subs;
+
+void setUp() {
+    subs = ClientSubscriptions<CLIENTS, TOPIC_COUNT>();
+    subs.begin(TOPICS);
+}
+void tearDown() {}
+
+void test_parses_rates() {
+    subs.connect(0);
+    TEST_ASSERT_EQUAL_INT8(TOPIC_STATUS, subs.subscribe(0, "status@4Hz"));
+    TEST_ASSERT_EQUAL_UINT16(250, subs.intervalMs(0, TOPIC_STATUS));
+    TEST_ASSERT_EQUAL_INT8(TOPIC_STATUS, subs.subscribe(0, "status@0.5Hz"));
+    TEST_ASSERT_EQUAL_UINT16(2000, subs.intervalMs(0, TOPIC_STATUS));
+    TEST_ASSERT_EQUAL_INT8(TOPIC_STATUS, subs.subscribe(0, "status@3Hz"));
+    TEST_ASSERT_EQUAL_UINT16(333, subs.intervalMs(0, TOPIC_STATUS)); // Rounded
+    TEST_ASSERT_EQUAL_INT8(TOPIC_STATUS, subs.subscribe(0, "status"));
+    TEST_ASSERT_EQUAL_UINT16(200, subs.intervalMs(0, TOPIC_STATUS)); // Topic default
+}
+
+void test_clamps_rates() {
+    subs.connect(0);
+    TEST_ASSERT_EQUAL_INT8(TOPIC_STATUS, subs.subscribe(0, "status@1000Hz"));
+    TEST_ASSERT_EQUAL_UINT16(50, subs.intervalMs(0, TOPIC_STATUS)); // Fastest produced
+    TEST_ASSERT_EQUAL_INT8(TOPIC_STATUS, subs.subscribe(0, "status@0.0001Hz"));
+    TEST_ASSERT_EQUAL_UINT16(SUBSCRIBE_MAX_INTERVAL_MS, subs.intervalMs(0, TOPIC_STATUS));
+}
+
+void test_rejects_bad_specs() {
+    subs.connect(0);
+    TEST_ASSERT_EQUAL_INT8(-1, subs.subscribe(0, "pressure@4Hz"));
+    TEST_ASSERT_EQUAL_INT8(-1, subs.subscribe(0, "status@4"));
+    TEST_ASSERT_EQUAL_INT8(-1, subs.subscribe(0, "status@Hz"));
+    TEST_ASSERT_EQUAL_INT8(-1, subs.subscribe(0, "status@"));
+    TEST_ASSERT_EQUAL_INT8(-1, subs.subscribe(0, "status@0Hz"));
+    TEST_ASSERT_EQUAL_INT8(-1, subs.subscribe(0, "status@-2Hz"));
+    TEST_ASSERT_EQUAL_INT8(-1, subs.subscribe(0, "status@4kHz"));
+    TEST_ASSERT_EQUAL_INT8(-1, subs.subscribe(CLIENTS, "status@4Hz"));
+    // Nothing changed: still the default set
+    TEST_ASSERT_EQUAL_UINT16(200, subs.intervalMs(0, TOPIC_STATUS));
+}
+
+// Until it asks, a client gets every default topic; its first subscribe
+// replaces that set, and opt-in topics need asking for
+void test_default_set_and_opt_in() {
+    subs.connect(0);
+    subs.connect(1);
+    TEST_ASSERT_EQUAL_HEX32(0x3, subs.subscribers(TOPIC_STATUS));
+    TEST_ASSERT_EQUAL_HEX32(0x0, subs.subscribers(TOPIC_SCOPE));
+
+    TEST_ASSERT_EQUAL_INT8(TOPIC_SCOPE, subs.subscribe(1, "scope"));
+    TEST_ASSERT_EQUAL_HEX32(0x1, subs.subscribers(TOPIC_STATUS)); // Client 1 dropped its defaults
+    TEST_ASSERT_EQUAL_HEX32(0x2, subs.subscribers(TOPIC_SCOPE));
+    TEST_ASSERT_EQUAL_UINT16(1, subs.intervalMs(1, TOPIC_SCOPE));
+
+    // A reused slot starts on the default set again
+    subs.disconnect(1);
+    subs.connect(1);
+    TEST_ASSERT_EQUAL_HEX32(0x3, subs.subscribers(TOPIC_STATUS));
+    TEST_ASSERT_EQUAL_HEX32(0x0, subs.subscribers(TOPIC_SCOPE));
+}
+
+// Each client is served at its own rate; updates in between coalesce
+void test_due_gates_per_client() {
+    subs.connect(0);
+    subs.connect(1);
+    subs.subscribe(0, "status@20Hz"); // 50 ms
+    subs.subscribe(1, "status@2Hz");  // 500 ms
+    TEST_ASSERT_EQUAL_HEX32(0x3, subs.due(TOPIC_STATUS, 1000)); // Current state after subscribing
+
+    uint32_t served[2] = {0, 0};
+    for (uint32_t t = 1010; t <= 2000; t += 10) {
+        subs.publish(TOPIC_STATUS); // A change every 10 ms
+        uint32_t due = subs.due(TOPIC_STATUS, t);
+        if (due & 1) served[0]++;
+        if (due & 2) served[1]++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(20, served[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, served[1]);
+
+    // Nothing new: nobody is due however long it has been
+    TEST_ASSERT_EQUAL_HEX32(0, subs.due(TOPIC_STATUS, 9000));
+}
+
+// State changes go out at once to everyone with something pending
+void test_forced_due_ignores_rate() {
+    subs.connect(0);
+    subs.subscribe(0, "status@0.5Hz");
+    subs.due(TOPIC_STATUS, 1000);
+    subs.publish(TOPIC_STATUS);
+    TEST_ASSERT_EQUAL_HEX32(0, subs.due(TOPIC_STATUS, 1100));
+    TEST_ASSERT_EQUAL_HEX32(0x1, subs.due(TOPIC_STATUS, 1100, true));
+    TEST_ASSERT_EQUAL_HEX32(0, subs.due(TOPIC_STATUS, 1100, true)); // Served
+}
+
+void test_unsubscribe() {
+    subs.connect(0);
+    subs.subscribe(0, "scope");
+    subs.subscribe(0, "status@10Hz");
+    subs.publish(TOPIC_STATUS);
+    TEST_ASSERT_TRUE(subs.unsubscribe(0, "status"));
+    TEST_ASSERT_EQUAL_HEX32(0, subs.subscribers(TOPIC_STATUS));
+    TEST_ASSERT_EQUAL_HEX32(0, subs.due(TOPIC_STATUS, 5000, true)); // Pending update dropped too
+    TEST_ASSERT_EQUAL_HEX32(0x1, subs.subscribers(TOPIC_SCOPE));    // The rest stays
+    TEST_ASSERT_FALSE(subs.unsubscribe(0, "pressure"));
+
+    // Unsubscribing from the default set keeps the other defaults
+    subs.connect(1);
+    TEST_ASSERT_TRUE(subs.unsubscribe(1, "scope"));
+    TEST_ASSERT_EQUAL_HEX32(0x2, subs.subscribers(TOPIC_STATUS));
+}
+
+// The producer runs at the fastest subscriber's rate, or the default
+void test_fastest_rate() {
+    TEST_ASSERT_EQUAL_UINT16(200, subs.fastestMs(TOPIC_STATUS));
+    subs.connect(0);
+    subs.connect(1);
+    subs.subscribe(0, "status@1Hz");
+    TEST_ASSERT_EQUAL_UINT16(200, subs.fastestMs(TOPIC_STATUS)); // Client 1 still on the default
+    subs.subscribe(1, "status@10Hz");
+    TEST_ASSERT_EQUAL_UINT16(100, subs.fastestMs(TOPIC_STATUS));
+    subs.disconnect(1);
+    TEST_ASSERT_EQUAL_UINT16(1000, subs.fastestMs(TOPIC_STATUS));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_parses_rates);
+    RUN_TEST(test_clamps_rates);
+    RUN_TEST(test_rejects_bad_specs);
+    RUN_TEST(test_default_set_and_opt_in);
+    RUN_TEST(test_due_gates_per_client);
+    RUN_TEST(test_forced_due_ignores_rate);
+    RUN_TEST(test_unsubscribe);
+    RUN_TEST(test_fastest_rate);
+    return UNITY_END();
+}
@@ -0,0 +1,238 @@
+// parseCommand() and nextCommandLine() against the sketches' command table:
+// every status for well-formed and malformed input, then the seeds from
+// test/fuzz/corpus with random mutations. Each input is copied to a heap
+// buffer of its exact length, so reading past the payload (there is no
+// NUL on the wire) shows up under AddressSanitizer. The benchmark reports
+// commands per second.
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flow_commands.h"
+
+// Same seeds as test/fuzz/corpus
+static const char *const SEEDS[] = {
+    "setTarget:500",
+    "toggle:13",
+    "resetBatch",
+    "format:bin",
+    "resume:4294967295",
+    "setRelay:1",
+    "subscribe:flow@4Hz",
+    "setCalib:744:0,3720:100",
+    "#17 setTarget:500\n#18 toggle:13",
+    "#1 history\r\n\r\n#2 resetCalib\n",
+    "setTarget:-0.5",
+    "resume:4294967296",
+    "toggle:13:1",
+    "#x toggle:13",
+};
+
+// A payload copied to a heap buffer of exactly its length. Parsed spans
+// point into it, so it must outlive the assertions on them.
+struct Payload {
+    char *p;
+    size_t len;
+
+    explicit Payload(const char *text) : len(strlen(text)) {
+        p = (char *)malloc(len ? len : 1);
+        memcpy(p, text, len);
+    }
+    ~Payload() { free(p); }
+    Payload(const Payload &) = delete;
+    Payload &operator=(const Payload &) = delete;
+
+    ParseStatus parse(ParsedCommand &cmd) const { return parseCommand(COMMANDS, TextSpan(p, len), cmd); }
+};
+
+static ParseStatus statusOf(const char *text) {
+    Payload payload(text);
+    ParsedCommand cmd;
+    return payload.parse(cmd);
+}
+
+// Walks a frame the way webSocketEvent() does; returns the number of lines
+static uint32_t walkFrame(const char *payload, size_t len) {
+    TextSpan frame(payload, len);
+    CommandLine line;
+    uint32_t lines = 0;
+    while (nextCommandLine(frame, line)) {
+        lines++;
+        TEST_ASSERT_TRUE(line.text.len <= len);
+        TEST_ASSERT_TRUE(line.text.p >= payload && line.text.p + line.text.len <= payload + len);
+        if (line.badId) continue;
+        ParsedCommand cmd;
+        if (parseCommand(COMMANDS, line.text, cmd) != PARSE_OK) continue;
+        for (uint8_t a = 0; a < COMMAND_MAX_ARGS && cmd.spec->args[a].type != ARG_NONE; a++) {
+            const CommandArg &arg = cmd.args[a];
+            const ArgSpec &spec = cmd.spec->args[a];
+            if (arg.text.p) TEST_ASSERT_TRUE(arg.text.p >= payload && arg.text.p + arg.text.len <= payload + len);
+            if (spec.type == ARG_FLOAT) TEST_ASSERT_TRUE(arg.f >= (float)spec.min && arg.f <= (float)spec.max);
+            if (spec.type == ARG_INT) TEST_ASSERT_TRUE(arg.i >= spec.min && arg.i <= spec.max);
+        }
+    }
+    return lines;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_parses_valid_commands() {
+    ParsedCommand cmd;
+    Payload target("setTarget:500");
+    TEST_ASSERT_EQUAL(PARSE_OK, target.parse(cmd));
+    TEST_ASSERT_EQUAL(OP_SET_TARGET, cmd.spec->id);
+    TEST_ASSERT_EQUAL_FLOAT(500.0f, cmd.args[0].f);
+
+    Payload toggle("toggle:13");
+    TEST_ASSERT_EQUAL(PARSE_OK, toggle.parse(cmd));
+    TEST_ASSERT_EQUAL(OP_TOGGLE, cmd.spec->id);
+    TEST_ASSERT_EQUAL_INT64(13, cmd.args[0].i);
+
+    Payload relay("setRelay:1");
+    TEST_ASSERT_EQUAL(PARSE_OK, relay.parse(cmd));
+    TEST_ASSERT_EQUAL(OP_SET_RELAY, cmd.spec->id);
+    TEST_ASSERT_EQUAL_INT64(1, cmd.args[0].i);
+
+    Payload reset("resetBatch");
+    TEST_ASSERT_EQUAL(PARSE_OK, reset.parse(cmd));
+    TEST_ASSERT_EQUAL(OP_RESET_BATCH, cmd.spec->id);
+}
+
+// The uint32 bounds are exact: 2^32 must not pass and wrap to 0 when the
+// sketch casts it, which would replay the whole event log
+void test_integer_bounds_are_exact() {
+    ParsedCommand cmd;
+    Payload last("resume:4294967295");
+    TEST_ASSERT_EQUAL(PARSE_OK, last.parse(cmd));
+    TEST_ASSERT_EQUAL_INT64(4294967295ll, cmd.args[0].i);
+    TEST_ASSERT_EQUAL_UINT32(4294967295u, (uint32_t)cmd.args[0].i);
+    TEST_ASSERT_EQUAL(PARSE_OUT_OF_RANGE, statusOf("resume:4294967296"));
+    TEST_ASSERT_EQUAL(PARSE_OUT_OF_RANGE, statusOf("resume:4294967297"));
+    TEST_ASSERT_EQUAL(PARSE_OUT_OF_RANGE, statusOf("setRelay:2"));
+}
+
+// ARG_TEXT takes the rest of the message, colons included
+void test_text_argument_keeps_colons() {
+    ParsedCommand cmd;
+    Payload calib("setCalib:744:0,3720:100");
+    TEST_ASSERT_EQUAL(PARSE_OK, calib.parse(cmd));
+    TEST_ASSERT_TRUE(cmd.args[0].text.equals("744:0,3720:100"));
+    Payload format("format:");
+    TEST_ASSERT_EQUAL(PARSE_OK, format.parse(cmd));
+    TEST_ASSERT_TRUE(cmd.args[0].text.empty());
+}
+
+void test_rejects_malformed_commands() {
+    TEST_ASSERT_EQUAL(PARSE_UNKNOWN, statusOf(""));
+    TEST_ASSERT_EQUAL(PARSE_UNKNOWN, statusOf("settarget:500"));
+    TEST_ASSERT_EQUAL(PARSE_UNKNOWN, statusOf("setTarget500"));
+    TEST_ASSERT_EQUAL(PARSE_UNKNOWN, statusOf("chTarget:0:5")); // Single-channel table
+    TEST_ASSERT_EQUAL(PARSE_MISSING, statusOf("setTarget"));
+    TEST_ASSERT_EQUAL(PARSE_EXTRA, statusOf("toggle:13:1"));
+    TEST_ASSERT_EQUAL(PARSE_EXTRA, statusOf("resetBatch:"));
+    TEST_ASSERT_EQUAL(PARSE_BAD_NUMBER, statusOf("setTarget:"));
+    TEST_ASSERT_EQUAL(PARSE_BAD_NUMBER, statusOf("setTarget:5e2"));
+    TEST_ASSERT_EQUAL(PARSE_BAD_NUMBER, statusOf("setTarget:nan"));
+    TEST_ASSERT_EQUAL(PARSE_BAD_NUMBER, statusOf("setTarget:1.2.3"));
+    TEST_ASSERT_EQUAL(PARSE_BAD_NUMBER, statusOf("toggle:13.0"));
+    TEST_ASSERT_EQUAL(PARSE_BAD_NUMBER, statusOf("toggle:-"));
+    TEST_ASSERT_EQUAL(PARSE_BAD_NUMBER, statusOf("resume:9999999999999999999"));
+    TEST_ASSERT_EQUAL(PARSE_OUT_OF_RANGE, statusOf("setTarget:-0.5"));
+    TEST_ASSERT_EQUAL(PARSE_OUT_OF_RANGE, statusOf("setTarget:1000000.1"));
+    TEST_ASSERT_EQUAL(PARSE_OUT_OF_RANGE, statusOf("toggle:40"));
+    TEST_ASSERT_EQUAL(PARSE_OUT_OF_RANGE, statusOf("resume:-1"));
+}
+
+void test_splits_pipelined_frame() {
+    static const char frame[] = "#17 setTarget:500\r\n\n#18 toggle:13\n#x toggle:13\n#4294967296 history\nresetBatch";
+    TextSpan rest(frame, sizeof(frame) - 1);
+    CommandLine line;
+
+    TEST_ASSERT_TRUE(nextCommandLine(rest, line));
+    TEST_ASSERT_TRUE(line.hasId && !line.badId);
+    TEST_ASSERT_EQUAL_UINT32(17, line.id);
+    TEST_ASSERT_TRUE(line.text.equals("setTarget:500"));
+
+    TEST_ASSERT_TRUE(nextCommandLine(rest, line)); // The blank line is skipped
+    TEST_ASSERT_EQUAL_UINT32(18, line.id);
+    TEST_ASSERT_TRUE(line.text.equals("toggle:13"));
+
+    TEST_ASSERT_TRUE(nextCommandLine(rest, line));
+    TEST_ASSERT_TRUE(line.badId);
+    TEST_ASSERT_TRUE(nextCommandLine(rest, line));
+    TEST_ASSERT_TRUE(line.badId); // Id past UINT32_MAX
+
+    TEST_ASSERT_TRUE(nextCommandLine(rest, line));
+    TEST_ASSERT_FALSE(line.hasId);
+    TEST_ASSERT_TRUE(line.text.equals("resetBatch"));
+    TEST_ASSERT_FALSE(nextCommandLine(rest, line));
+}
+
+// Random byte flips, inserts and truncations of the seeds: nothing may read
+// outside the payload and every accepted argument must be within its range
+void test_mutated_seeds() {
+    const uint32_t rounds = 200000;
+    char buffer[96];
+    uint32_t seed = 1;
+    uint32_t lines = 0;
+    for (uint32_t r = 0; r < rounds; r++) {
+        const char *base = SEEDS[r % (sizeof(SEEDS) / sizeof(SEEDS[0]))];
+        size_t len = strlen(base);
+        memcpy(buffer, base, len);
+        for (uint8_t m = 0; m < 3; m++) {
+            seed = seed * 1664525u + 1013904223u;
+            size_t at = len ? (seed >> 8) % len : 0;
+            char c = (char)(seed >> 24);
+            if ((seed >> 30) == 0) {
+                if (len) buffer[at] = c; // Flip a byte
+            } else if ((seed >> 30) == 1) {
+                len = at; // Truncate
+            } else if (len < sizeof(buffer)) {
+                // Insert a random byte, or one the grammar cares about
+                if ((seed >> 30) == 3) c = "\n:#- .0"[(seed >> 16) % 7];
+                memmove(buffer + at + 1, buffer + at, len - at);
+                buffer[at] = c;
+                len++;
+            }
+        }
+        char *payload = (char *)malloc(len ? len : 1);
+        memcpy(payload, buffer, len);
+        lines += walkFrame(payload, len);
+        free(payload);
+    }
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%u mutated frames, %u lines", rounds, lines);
+    TEST_MESSAGE(msg);
+}
+
+// Host timing only; the parser does the same work on the ESP32
+void test_benchmark_parse() {
+    static const char frame[] = "#17 setTarget:500\n#18 toggle:13\n#19 resetBatch\n#20 setCalib:744:0,3720:100";
+    const uint32_t n = 1000000;
+    volatile uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; i++) {
+        TextSpan rest(frame, sizeof(frame) - 1);
+        CommandLine line;
+        ParsedCommand cmd;
+        while (nextCommandLine(rest, line)) sink = sink + parseCommand(COMMANDS, line.text, cmd) + line.id;
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%.0f commands/s (%.0f ns each)", 4 * n / s, s * 1e9 / (4 * n));
+    TEST_MESSAGE(msg);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_parses_valid_commands);
+    RUN_TEST(test_integer_bounds_are_exact);
+    RUN_TEST(test_text_argument_keeps_colons);
+    RUN_TEST(test_rejects_malformed_commands);
+    RUN_TEST(test_splits_pipelined_frame);
+    RUN_TEST(test_mutated_seeds);
+    RUN_TEST(test_benchmark_parse);
+    return UNITY_END();
+}
@@ -0,0 +1,121 @@
+// EventLog resume logic: covers() and eventAfter() must replay exactly the
+// events a reconnecting client missed, once each and in order, including
+// across the 2^32 sequence wrap, and must refuse when some were evicted or
+// the number is not from this boot. A wrong answer silently drops or
+// duplicates pump events.
+#include <unity.h>
+#include "event_log.h"
+
+#define LOG_SIZE 8
+
+static EventLog<uint32_t, LOG_SIZE> log8;
+
+// What pumpResumes() does: replay everything after `after`
+static uint32_t replay(uint32_t after, uint32_t *events, uint32_t max) {
+    uint32_t n = 0, seq;
+    uint32_t event;
+    while (n < max && log8.eventAfter(after, seq, event)) {
+        events[n++] = event;
+        after = seq;
+    }
+    return n;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_replays_missed_events_in_order() {
+    log8.begin(1000);
+    uint32_t seen = log8.next(); // Status the client got
+    log8.append(1);
+    log8.next();                 // Status: not logged
+    log8.append(2);
+    log8.append(3);
+
+    TEST_ASSERT_TRUE(log8.covers(seen));
+    uint32_t events[LOG_SIZE];
+    TEST_ASSERT_EQUAL_UINT32(3, replay(seen, events, LOG_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(1, events[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, events[1]);
+    TEST_ASSERT_EQUAL_UINT32(3, events[2]);
+
+    // Up to date: covered, nothing to send
+    TEST_ASSERT_TRUE(log8.covers(log8.seq()));
+    TEST_ASSERT_EQUAL_UINT32(0, replay(log8.seq(), events, LOG_SIZE));
+}
+
+// The sequence wraps from 2^32 - 1 to 0 mid-log
+void test_replays_across_sequence_wrap() {
+    log8.begin(0xfffffffdu);
+    uint32_t seen = log8.append(10); // 0xfffffffd
+    uint32_t a = log8.append(11);    // 0xfffffffe
+    uint32_t b = log8.append(12);    // 0xffffffff
+    uint32_t c = log8.append(13);    // 0
+    uint32_t d = log8.append(14);    // 1
+    TEST_ASSERT_EQUAL_UINT32(0xfffffffeu, a);
+    TEST_ASSERT_EQUAL_UINT32(0xffffffffu, b);
+    TEST_ASSERT_EQUAL_UINT32(0, c);
+    TEST_ASSERT_EQUAL_UINT32(1, d);
+
+    TEST_ASSERT_TRUE(log8.covers(seen));
+    uint32_t events[LOG_SIZE];
+    TEST_ASSERT_EQUAL_UINT32(4, replay(seen, events, LOG_SIZE));
+    for (uint32_t i = 0; i < 4; i++) TEST_ASSERT_EQUAL_UINT32(11 + i, events[i]);
+
+    // From the far side of the wrap
+    TEST_ASSERT_TRUE(log8.covers(c));
+    TEST_ASSERT_EQUAL_UINT32(1, replay(c, events, LOG_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(14, events[0]);
+}
+
+// Once an event the client missed is overwritten, replay must not start
+void test_refuses_after_eviction() {
+    log8.begin(0xfffffff0u);
+    uint32_t seen = log8.append(0);
+    uint32_t seqs[LOG_SIZE + 1];
+    for (uint32_t i = 1; i <= LOG_SIZE; i++) seqs[i] = log8.append(i); // Evicts `seen` only
+    TEST_ASSERT_TRUE(log8.covers(seen)); // Everything after it is still here
+    uint32_t events[LOG_SIZE + 1];
+    TEST_ASSERT_EQUAL_UINT32(LOG_SIZE, replay(seen, events, LOG_SIZE + 1));
+
+    log8.append(LOG_SIZE + 1); // Evicts seqs[1], which the client missed
+    TEST_ASSERT_FALSE(log8.covers(seen));
+    TEST_ASSERT_TRUE(log8.covers(seqs[1]));
+    TEST_ASSERT_EQUAL_UINT32(LOG_SIZE, replay(seqs[1], events, LOG_SIZE + 1));
+    TEST_ASSERT_EQUAL_UINT32(2, events[0]);
+}
+
+// Eviction bookkeeping also holds across the wrap
+void test_eviction_across_wrap() {
+    log8.begin(0xfffffffcu);
+    uint32_t seen = log8.seq();
+    for (uint32_t i = 0; i < 20; i++) log8.append(i);
+    TEST_ASSERT_FALSE(log8.covers(seen));
+    uint32_t oldest = log8.seq() - LOG_SIZE; // Last number evicted
+    TEST_ASSERT_TRUE(log8.covers(oldest));
+    TEST_ASSERT_FALSE(log8.covers(oldest - 1));
+    uint32_t events[LOG_SIZE];
+    TEST_ASSERT_EQUAL_UINT32(LOG_SIZE, replay(oldest, events, LOG_SIZE));
+    for (uint32_t i = 0; i < LOG_SIZE; i++) TEST_ASSERT_EQUAL_UINT32(12 + i, events[i]);
+}
+
+// A number from another boot, or from the future, forces a resync
+void test_refuses_foreign_numbers() {
+    log8.begin(5000);
+    log8.append(1);
+    log8.append(2);
+    TEST_ASSERT_FALSE(log8.covers(log8.seq() + 1));
+    TEST_ASSERT_FALSE(log8.covers(123456789));
+    TEST_ASSERT_FALSE(log8.covers(4998));
+    TEST_ASSERT_TRUE(log8.covers(4999)); // Before anything was handed out
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_replays_missed_events_in_order);
+    RUN_TEST(test_replays_across_sequence_wrap);
+    RUN_TEST(test_refuses_after_eviction);
+    RUN_TEST(test_eviction_across_wrap);
+    RUN_TEST(test_refuses_foreign_numbers);
+    return UNITY_END();
+}
@@ -0,0 +1,139 @@
+// FlowCalibration against reference curves: the lookup table must agree
+// with direct piecewise-linear interpolation at every ADC code, clamp at
+// both ends and keep monotonic curves monotonic.
+#include <unity.h>
+#include "flow_calibration.h"
+
+// Table resolution: entries are rounded to 0.01 L/min
+#define TABLE_STEP (1.0f / CALIB_FLOW_SCALE)
+
+// The sketches' default: 4-20 mA on the 12-bit ADC -> 0-100 L/min
+static const CalibPoint LINEAR_4_20[] = {{744, 0.0f}, {3720, 100.0f}};
+
+// Orifice-style curve, flow ~ sqrt(dp): steep at the low end, flattening out
+static const CalibPoint ORIFICE[] = {
+    {500, 0.0f}, {700, 14.1f}, {1000, 24.5f}, {1600, 37.4f}, {2400, 49.0f}, {3500, 61.6f}, {4000, 66.3f},
+};
+
+static FlowCalibration<4096> calibration;
+
+// Direct interpolation over the breakpoints, flat outside them
+static float reference(const CalibPoint *points, uint8_t count, float raw) {
+    if (raw <= points[0].raw) return points[0].flow;
+    if (raw >= points[count - 1].raw) return points[count - 1].flow;
+    uint8_t i = 1;
+    while (raw > points[i].raw) i++;
+    const CalibPoint &a = points[i - 1], &b = points[i];
+    return a.flow + (b.flow - a.flow) * (raw - a.raw) / (b.raw - a.raw);
+}
+
+static void checkEveryCode(const CalibPoint *points, uint8_t count) {
+    TEST_ASSERT_TRUE(calibration.load(points, count));
+    for (uint32_t code = 0; code < 4096; code++) {
+        TEST_ASSERT_FLOAT_WITHIN(TABLE_STEP / 2 + 1e-4f, reference(points, count, code), calibration.lookup(code));
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_linear_curve_matches_reference() {
+    checkEveryCode(LINEAR_4_20, 2);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, calibration.lookup(744));
+    TEST_ASSERT_EQUAL_FLOAT(50.0f, calibration.lookup(2232));
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, calibration.lookup(3720));
+}
+
+void test_segmented_curve_matches_reference() {
+    checkEveryCode(ORIFICE, 7);
+    for (uint8_t i = 0; i < 7; i++) TEST_ASSERT_FLOAT_WITHIN(TABLE_STEP / 2, ORIFICE[i].flow, calibration.lookup(ORIFICE[i].raw));
+}
+
+// Oversampled readings fall between codes
+void test_fractional_codes_interpolate() {
+    TEST_ASSERT_TRUE(calibration.load(ORIFICE, 7));
+    for (float raw = 500; raw < 4000; raw += 0.37f) {
+        TEST_ASSERT_FLOAT_WITHIN(TABLE_STEP, reference(ORIFICE, 7, raw), calibration.lookup(raw));
+    }
+}
+
+void test_clamps_below_first_point() {
+    TEST_ASSERT_TRUE(calibration.load(LINEAR_4_20, 2));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, calibration.lookup(0));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, calibration.lookup(743));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, calibration.lookup(-25.0f)); // Offset-corrected reading below zero
+    TEST_ASSERT_EQUAL_UINT16(0, calibration.lookupScaled(0));
+}
+
+void test_clamps_above_last_point() {
+    TEST_ASSERT_TRUE(calibration.load(LINEAR_4_20, 2));
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, calibration.lookup(3721));
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, calibration.lookup(4095));
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, calibration.lookup(9000.0f));
+    TEST_ASSERT_EQUAL_UINT16(100 * CALIB_FLOW_SCALE, calibration.lookupScaled(65535));
+}
+
+// Flows past the table's range saturate instead of wrapping
+void test_saturates_table_range() {
+    static const CalibPoint huge[] = {{0, 0.0f}, {4095, 900.0f}};
+    TEST_ASSERT_TRUE(calibration.load(huge, 2));
+    TEST_ASSERT_EQUAL_UINT16(65535, calibration.lookupScaled(4095));
+}
+
+void test_monotonic_segments_stay_monotonic() {
+    TEST_ASSERT_TRUE(calibration.load(ORIFICE, 7));
+    for (uint16_t code = 1; code < 4096; code++) {
+        TEST_ASSERT_TRUE(calibration.lookupScaled(code) >= calibration.lookupScaled(code - 1));
+    }
+    float last = calibration.lookup(0.0f);
+    for (float raw = 0; raw < 4096; raw += 0.25f) {
+        float flow = calibration.lookup(raw);
+        TEST_ASSERT_TRUE(flow >= last);
+        last = flow;
+    }
+}
+
+void test_rejects_invalid_curves() {
+    static const CalibPoint notIncreasing[] = {{100, 0.0f}, {100, 5.0f}};
+    static const CalibPoint negative[] = {{100, 0.0f}, {200, -1.0f}};
+    CalibPoint tooMany[CALIB_MAX_POINTS + 1];
+    for (uint8_t i = 0; i <= CALIB_MAX_POINTS; i++) tooMany[i] = {(uint16_t)(i * 100), (float)i};
+    TEST_ASSERT_FALSE(calibValid(notIncreasing, 2));
+    TEST_ASSERT_FALSE(calibValid(negative, 2));
+    TEST_ASSERT_FALSE(calibValid(LINEAR_4_20, 1));
+    TEST_ASSERT_FALSE(calibValid(tooMany, CALIB_MAX_POINTS + 1));
+    TEST_ASSERT_TRUE(calibValid(tooMany, CALIB_MAX_POINTS));
+
+    // A rejected curve leaves the loaded one in place
+    TEST_ASSERT_TRUE(calibration.load(LINEAR_4_20, 2));
+    TEST_ASSERT_FALSE(calibration.load(negative, 2));
+    TEST_ASSERT_EQUAL_UINT8(2, calibration.count());
+    TEST_ASSERT_EQUAL_FLOAT(50.0f, calibration.lookup(2232));
+}
+
+void test_parses_calibration_text() {
+    CalibPoint points[CALIB_MAX_POINTS];
+    TEST_ASSERT_EQUAL_UINT8(2, parseCalibration(TextSpan("744:0,3720:100"), points));
+    TEST_ASSERT_EQUAL_UINT16(3720, points[1].raw);
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, points[1].flow);
+    TEST_ASSERT_EQUAL_UINT8(0, parseCalibration(TextSpan("744-0,3720:100"), points));
+    TEST_ASSERT_EQUAL_UINT8(0, parseCalibration(TextSpan("70000:1,70001:2"), points));
+    TEST_ASSERT_EQUAL_UINT8(0, parseCalibration(TextSpan("1:a,2:3"), points));
+    TEST_ASSERT_EQUAL_UINT8(0, parseCalibration(TextSpan("1:1,2:2,3:3,4:4,5:5,6:6,7:7,8:8,9:9,10:10,11:11,12:12,"
+                                                         "13:13,14:14,15:15,16:16,17:17"),
+                                                points));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_linear_curve_matches_reference);
+    RUN_TEST(test_segmented_curve_matches_reference);
+    RUN_TEST(test_fractional_codes_interpolate);
+    RUN_TEST(test_clamps_below_first_point);
+    RUN_TEST(test_clamps_above_last_point);
+    RUN_TEST(test_saturates_table_range);
+    RUN_TEST(test_monotonic_segments_stay_monotonic);
+    RUN_TEST(test_rejects_invalid_curves);
+    RUN_TEST(test_parses_calibration_text);
+    return UNITY_END();
+}
@@ -0,0 +1,86 @@
+// FlowTotalizer over a simulated 24 h batch: the integer total must equal
+// the exact trapezoid sum, with no drift however small each step is.
+#include <unity.h>
+#include <stdio.h>
+#include "flow_totalizer.h"
+
+static const uint64_t DAY_US = 24ull * 3600 * 1000000;
+
+void setUp() {}
+void tearDown() {}
+
+// Constant flow at the fastest control rate (1 kHz): every step adds
+// 12.345 L/min * 1 ms = 205.75 uL, whose fraction a per-step rounding
+// would lose
+void test_constant_flow_24h_exact() {
+    FlowTotalizer total;
+    float naive = 0; // What a float accumulator in litres would report
+    const uint32_t dtUs = 1000;
+    total.add(12.345f, 0);
+    for (uint64_t t = 0; t < DAY_US; t += dtUs) {
+        total.add(12.345f, dtUs);
+        naive += 12.345f / 60.0f * dtUs * 1e-6f;
+    }
+    // 12.345 L/min for 1440 min
+    TEST_ASSERT_EQUAL_INT64(17776800000ll, total.microLitres());
+    char msg[96];
+    snprintf(msg, sizeof(msg), "exact 17776.800000 L, totalizer %.6f L, float accumulator %.3f L",
+             total.microLitres() * 1e-6, naive);
+    TEST_MESSAGE(msg);
+}
+
+// Varying flow with jittered intervals (10 Hz nominal): the total is
+// floor(sum((f0 + f1) * dt) / 120000), i.e. nothing is lost between steps
+void test_varying_flow_24h_matches_exact_sum() {
+    FlowTotalizer total;
+    uint32_t seed = 7;
+    int64_t exactNum = 0; // Sum of (f0 + f1) * dt, mL/min * us
+    int32_t last = 0;
+    total.addMilli(0, 0);
+    for (uint64_t t = 0; t < DAY_US;) {
+        seed = seed * 1664525u + 1013904223u;
+        int32_t flow = (int32_t)(seed >> 17); // 0 .. 32.767 L/min
+        uint32_t dtUs = 99000 + (seed & 0x7ff); // 99 .. 101 ms
+        total.addMilli(flow, dtUs);
+        exactNum += (int64_t)(last + flow) * dtUs;
+        last = flow;
+        t += dtUs;
+    }
+    TEST_ASSERT_EQUAL_INT64(exactNum / 120000, total.microLitres());
+}
+
+// Flow too small to register in one step still adds up over a day
+void test_trickle_flow_accumulates() {
+    FlowTotalizer total;
+    total.addMilli(1, 0);
+    for (uint64_t t = 0; t < DAY_US; t += 1000) total.addMilli(1, 1000); // 1 mL/min, 1/60 uL per step
+    TEST_ASSERT_EQUAL_INT64(1440000, total.microLitres()); // 1.44 L
+}
+
+// A hold() between runs starts the next trapezoid from the held flow and
+// integrates nothing while the pump is off
+void test_hold_integrates_nothing() {
+    FlowTotalizer total;
+    total.add(6.0f, 0);
+    total.add(6.0f, 1000000); // 100 mL
+    total.hold(0);
+    total.hold(6.0f);
+    total.add(6.0f, 1000000); // 100 mL
+    TEST_ASSERT_EQUAL_INT64(200000, total.microLitres());
+}
+
+void test_litre_conversions() {
+    TEST_ASSERT_EQUAL_INT64(1000000000ll, FlowTotalizer::fromLitres(1000.0f));
+    TEST_ASSERT_EQUAL_INT64(500000, FlowTotalizer::fromLitres(0.5f));
+    TEST_ASSERT_EQUAL_INT32(12345, FlowTotalizer::toMilliLpm(12.345f));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_constant_flow_24h_exact);
+    RUN_TEST(test_varying_flow_24h_matches_exact_sum);
+    RUN_TEST(test_trickle_flow_accumulates);
+    RUN_TEST(test_hold_integrates_nothing);
+    RUN_TEST(test_litre_conversions);
+    return UNITY_END();
+}
@@ -0,0 +1,115 @@
+// HistoryRing as the dashboard decodes it: one point per period with the
+// mean flow and the closing volume, oldest-first through header.oldest
+// once the ring wraps, flow clamped to the 16-bit field, and a message
+// that fits the sketch's 16-bit transfer counter at full size.
+#include <unity.h>
+#include <string.h>
+#include "history_ring.h"
+
+#define POINTS 1800 // The sketch's 30 min at 1 s
+#define PERIOD_MS 1000
+
+static HistoryRing<POINTS> ring;
+static HistoryRing<4> small;
+
+// Point `i` in wire order, as loadHistory() in include/index_html.h reads it
+static HistoryPoint pointAt(const uint8_t *message, uint16_t i) {
+    HistoryHeader h;
+    memcpy(&h, message, sizeof(h));
+    HistoryPoint p;
+    memcpy(&p, message + sizeof(h) + ((h.oldest + i) % h.count) * sizeof(HistoryPoint), sizeof(p));
+    return p;
+}
+
+static HistoryHeader headerOf(const uint8_t *message) {
+    HistoryHeader h;
+    memcpy(&h, message, sizeof(h));
+    return h;
+}
+
+void setUp() {
+    ring.begin(PERIOD_MS, 0);
+    small.begin(PERIOD_MS, 0);
+}
+void tearDown() {}
+
+// Readings every 250 ms: four per point, averaged; the volume at the end
+void test_decimates_to_one_point_per_period() {
+    uint32_t t = 0;
+    for (uint8_t i = 0; i < 4; i++) small.sample(1.0f + i, 0.5f * i, t += 250, false);
+    TEST_ASSERT_EQUAL_UINT16(1, small.count());
+    HistoryPoint p = pointAt(small.message(), 0);
+    TEST_ASSERT_EQUAL_UINT16(250, p.flow); // Mean 2.5 L/min
+    TEST_ASSERT_EQUAL_FLOAT(1.5f, p.volume);
+
+    small.sample(9.0f, 2.0f, t += 250, false); // Not a full period yet
+    TEST_ASSERT_EQUAL_UINT16(1, small.count());
+}
+
+void test_wraps_oldest_first() {
+    for (uint32_t i = 1; i <= 6; i++) small.sample((float)i, (float)i, i * PERIOD_MS, false);
+    HistoryHeader h = headerOf(small.message());
+    TEST_ASSERT_EQUAL_UINT16(4, h.count);
+    TEST_ASSERT_EQUAL_UINT16(2, h.oldest);
+    for (uint16_t i = 0; i < 4; i++) {
+        HistoryPoint p = pointAt(small.message(), i);
+        TEST_ASSERT_EQUAL_FLOAT(3.0f + i, p.volume); // Points 3..6 survive
+        TEST_ASSERT_EQUAL_UINT16((3 + i) * HISTORY_FLOW_SCALE, p.flow);
+    }
+}
+
+// 0 .. 655.35 L/min fits the field; the rest saturates instead of wrapping
+void test_clamps_flow_to_16_bits() {
+    small.sample(700.0f, 0, 1 * PERIOD_MS, false);
+    small.sample(-3.0f, 0, 2 * PERIOD_MS, false);
+    small.sample(655.34f, 0, 3 * PERIOD_MS, false);
+    TEST_ASSERT_EQUAL_UINT16(65535, pointAt(small.message(), 0).flow);
+    TEST_ASSERT_EQUAL_UINT16(0, pointAt(small.message(), 1).flow);
+    TEST_ASSERT_EQUAL_UINT16(65534, pointAt(small.message(), 2).flow);
+}
+
+// A transfer holds the ring still; the readings go into the next point
+void test_hold_freezes_ring() {
+    small.sample(1.0f, 1.0f, 1 * PERIOD_MS, false);
+    small.sample(3.0f, 2.0f, 2 * PERIOD_MS, true);
+    small.sample(5.0f, 3.0f, 3 * PERIOD_MS, true);
+    TEST_ASSERT_EQUAL_UINT16(1, small.count());
+    small.sample(7.0f, 4.0f, 4 * PERIOD_MS, false);
+    TEST_ASSERT_EQUAL_UINT16(2, small.count());
+    HistoryPoint p = pointAt(small.message(), 1);
+    TEST_ASSERT_EQUAL_UINT16(500, p.flow); // Mean of 3, 5 and 7
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, p.volume);
+}
+
+void test_header_and_age() {
+    small.sample(1.0f, 1.0f, 1000, false);
+    small.stamp(1750);
+    HistoryHeader h = headerOf(small.message());
+    TEST_ASSERT_EQUAL_UINT8(STATUS_FRAME_VERSION, h.version);
+    TEST_ASSERT_EQUAL_UINT8(FRAME_HISTORY, h.type);
+    TEST_ASSERT_EQUAL_UINT32(PERIOD_MS, h.periodMs);
+    TEST_ASSERT_EQUAL_UINT32(750, h.ageMs);
+    TEST_ASSERT_EQUAL_size_t(sizeof(HistoryHeader) + sizeof(HistoryPoint), small.messageBytes());
+}
+
+// 30 min full: 14 + 1800 * 6 bytes, which historySent (uint16_t) must hold
+void test_full_ring_fits_transfer_counter() {
+    for (uint32_t i = 1; i <= POINTS + 10; i++) ring.sample(1.0f, (float)i, i * PERIOD_MS, false);
+    TEST_ASSERT_EQUAL_UINT16(POINTS, ring.count());
+    TEST_ASSERT_EQUAL_size_t(10814, ring.messageBytes());
+    TEST_ASSERT_EQUAL_size_t(ring.messageBytes(), HistoryRing<POINTS>::maxMessageBytes());
+    TEST_ASSERT_TRUE(HistoryRing<POINTS>::maxMessageBytes() <= UINT16_MAX);
+    TEST_ASSERT_EQUAL_FLOAT(11.0f, pointAt(ring.message(), 0).volume);
+    TEST_ASSERT_EQUAL_FLOAT(POINTS + 10.0f, pointAt(ring.message(), POINTS - 1).volume);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_decimates_to_one_point_per_period);
+    RUN_TEST(test_wraps_oldest_first);
+    RUN_TEST(test_clamps_flow_to_16_bits);
+    RUN_TEST(test_hold_freezes_ring);
+    RUN_TEST(test_header_and_age);
+    RUN_TEST(test_full_ring_fits_transfer_counter);
+    return UNITY_END();
+}
@@ -0,0 +1,117 @@
+// KalmanFilter<float> and KalmanFilter<Q16_16> against the float filter the
+// sketches carried before kalman_filter.h, plus a timing comparison.
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include "kalman_filter.h"
+
+// The original per-sketch filter: full covariance recursion every update
+class ReferenceKalman {
+    float _q, _r, _p, _x, _k;
+public:
+    ReferenceKalman(float q, float r, float p, float initial) : _q(q), _r(r), _p(p), _x(initial) {}
+    float update(float measurement) {
+        _p = _p + _q;
+        _k = _p / (_p + _r);
+        _x = _x + _k * (measurement - _x);
+        _p = (1 - _k) * _p;
+        return _x;
+    }
+};
+
+// Flow-like input in L/min: steps between plateaus plus uniform noise from
+// a fixed LCG, so every run sees the same samples
+static float sampleAt(uint32_t i, uint32_t &seed) {
+    seed = seed * 1664525u + 1013904223u;
+    float noise = ((seed >> 8) / 16777216.0f - 0.5f) * 0.8f;
+    static const float plateaus[] = {0.0f, 12.5f, 30.0f, 4.0f, 18.0f};
+    return plateaus[(i / 2000) % 5] + noise;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_steady_gain_matches_closed_form() {
+    const double q = 0.01, r = 0.1;
+    double p = (q + sqrt(q * q + 4 * q * r)) / 2;
+    TEST_ASSERT_FLOAT_WITHIN(1e-7, p / (p + r), kalmanSteadyGain(q, r));
+}
+
+void test_converges_to_steady_gain() {
+    KalmanFilter<float> filter(0.01, 0.1, 1.0, 0.0);
+    uint32_t updates = 0;
+    while (!filter.converged() && updates < 1000) {
+        filter.update(1.0f);
+        updates++;
+    }
+    TEST_ASSERT_TRUE(filter.converged());
+    TEST_ASSERT_LESS_OR_EQUAL(50, updates);
+    TEST_ASSERT_EQUAL_FLOAT(kalmanSteadyGain(0.01, 0.1), filter.gain());
+}
+
+void test_float_tracks_reference() {
+    ReferenceKalman reference(0.01, 0.1, 1.0, 0.0);
+    KalmanFilter<float> filter(0.01, 0.1, 1.0, 0.0);
+    uint32_t seed = 1;
+    float worst = 0;
+    for (uint32_t i = 0; i < 20000; i++) {
+        float z = sampleAt(i, seed);
+        float d = fabsf(reference.update(z) - filter.update(z));
+        if (d > worst) worst = d;
+    }
+    char msg[64];
+    snprintf(msg, sizeof(msg), "max deviation %.2e L/min", worst);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_THAN_FLOAT(1e-4f, worst);
+}
+
+void test_q16_tracks_reference() {
+    ReferenceKalman reference(0.01, 0.1, 1.0, 0.0);
+    KalmanFilter<Q16_16> filter(0.01, 0.1, 1.0, 0.0);
+    uint32_t seed = 1;
+    float worst = 0;
+    for (uint32_t i = 0; i < 20000; i++) {
+        float z = sampleAt(i, seed);
+        float d = fabsf(reference.update(z) - filter.update(z));
+        if (d > worst) worst = d;
+    }
+    char msg[64];
+    snprintf(msg, sizeof(msg), "max deviation %.2e L/min", worst);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_THAN_FLOAT(1e-3f, worst);
+}
+
+// Host timing only; the ratio, not the figure, carries over to the ESP32
+template <typename F>
+static double nsPerUpdate(F &filter) {
+    const uint32_t n = 2000000;
+    uint32_t seed = 1;
+    static float input[4096];
+    for (uint32_t i = 0; i < 4096; i++) input[i] = sampleAt(i, seed);
+    volatile float sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; i++) sink = filter.update(input[i & 4095]);
+    auto end = std::chrono::steady_clock::now();
+    (void)sink;
+    return std::chrono::duration<double, std::nano>(end - start).count() / n;
+}
+
+void test_benchmark_update() {
+    ReferenceKalman reference(0.01, 0.1, 1.0, 0.0);
+    KalmanFilter<float> filter(0.01, 0.1, 1.0, 0.0);
+    KalmanFilter<Q16_16> fixed(0.01, 0.1, 1.0, 0.0);
+    char msg[96];
+    snprintf(msg, sizeof(msg), "ns/update: reference %.2f, float %.2f, Q16.16 %.2f", nsPerUpdate(reference),
+             nsPerUpdate(filter), nsPerUpdate(fixed));
+    TEST_MESSAGE(msg);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_gain_matches_closed_form);
+    RUN_TEST(test_converges_to_steady_gain);
+    RUN_TEST(test_float_tracks_reference);
+    RUN_TEST(test_q16_tracks_reference);
+    RUN_TEST(test_benchmark_update);
+    return UNITY_END();
+}
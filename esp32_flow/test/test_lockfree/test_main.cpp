@@ -0,0 +1,157 @@
+// SeqLock and SpscRing under real concurrency: pthreads stand in for the
+// two cores. A reader must never see a snapshot mixed from two publishes,
+// and the ring must hand over every item intact and in order.
+#include <unity.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include "seqlock.h"
+#include "spsc_ring.h"
+
+#define SEQLOCK_PUBLISHES 2000000
+#define SEQLOCK_READERS 3
+#define RING_ITEMS 5000000
+
+// Every word is derived from the publish number, so a torn copy shows up
+// as words that disagree
+struct Snapshot {
+    uint32_t number;
+    uint32_t words[14];
+    uint32_t check;
+};
+
+static void fill(Snapshot &s, uint32_t number) {
+    s.number = number;
+    for (uint32_t i = 0; i < 14; i++) s.words[i] = number * 2654435761u + i;
+    s.check = ~number;
+}
+
+static bool intact(const Snapshot &s) {
+    for (uint32_t i = 0; i < 14; i++) {
+        if (s.words[i] != s.number * 2654435761u + i) return false;
+    }
+    return s.check == ~s.number;
+}
+
+static SeqLock<Snapshot> snapshot;
+static std::atomic<bool> writerDone{false};
+
+struct ReaderResult {
+    uint32_t reads;
+    uint32_t torn;
+    uint32_t backwards;
+};
+
+static void *seqlockWriter(void *) {
+    Snapshot s;
+    for (uint32_t n = 1; n <= SEQLOCK_PUBLISHES; n++) {
+        fill(s, n);
+        snapshot.write(s);
+    }
+    writerDone.store(true);
+    return nullptr;
+}
+
+static void *seqlockReader(void *arg) {
+    ReaderResult *r = (ReaderResult *)arg;
+    uint32_t last = 0;
+    while (!writerDone.load()) {
+        Snapshot s = snapshot.read();
+        r->reads++;
+        if (!intact(s)) r->torn++;
+        if (s.number < last) r->backwards++;
+        last = s.number;
+    }
+    return nullptr;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_seqlock_never_tears() {
+    Snapshot first;
+    fill(first, 0);
+    snapshot.write(first);
+    writerDone.store(false);
+
+    pthread_t writer, readers[SEQLOCK_READERS];
+    ReaderResult results[SEQLOCK_READERS] = {};
+    for (int i = 0; i < SEQLOCK_READERS; i++) pthread_create(&readers[i], nullptr, seqlockReader, &results[i]);
+    pthread_create(&writer, nullptr, seqlockWriter, nullptr);
+    pthread_join(writer, nullptr);
+    for (int i = 0; i < SEQLOCK_READERS; i++) pthread_join(readers[i], nullptr);
+
+    uint32_t reads = 0;
+    for (int i = 0; i < SEQLOCK_READERS; i++) {
+        TEST_ASSERT_EQUAL_UINT32(0, results[i].torn);
+        TEST_ASSERT_EQUAL_UINT32(0, results[i].backwards);
+        reads += results[i].reads;
+    }
+    TEST_ASSERT_GREATER_THAN(0, reads);
+    TEST_ASSERT_EQUAL_UINT32(SEQLOCK_PUBLISHES + 1, snapshot.version());
+    TEST_ASSERT_EQUAL_UINT32(SEQLOCK_PUBLISHES, snapshot.read().number);
+
+    char msg[80];
+    snprintf(msg, sizeof(msg), "%u publishes, %u concurrent reads, none torn", SEQLOCK_PUBLISHES, reads);
+    TEST_MESSAGE(msg);
+}
+
+// Same shape as a control event: several words checked against each other
+struct Item {
+    uint32_t seq;
+    uint32_t a;
+    uint32_t b;
+};
+
+static SpscRing<Item, 16> ring;
+
+static void *ringProducer(void *) {
+    for (uint32_t n = 0; n < RING_ITEMS; n++) {
+        Item item = {n, n * 7u, ~n};
+        while (!ring.push(item)) sched_yield(); // Full: let the consumer catch up
+    }
+    return nullptr;
+}
+
+void test_spsc_ring_hands_over_in_order() {
+    pthread_t producer;
+    pthread_create(&producer, nullptr, ringProducer, nullptr);
+    uint32_t expect = 0, corrupt = 0, outOfOrder = 0;
+    Item item;
+    while (expect < RING_ITEMS) {
+        if (!ring.pop(item)) {
+            sched_yield();
+            continue;
+        }
+        if (item.a != item.seq * 7u || item.b != ~item.seq) corrupt++;
+        if (item.seq != expect) outOfOrder++;
+        expect = item.seq + 1;
+    }
+    pthread_join(producer, nullptr);
+    TEST_ASSERT_EQUAL_UINT32(0, corrupt);
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_FALSE(ring.pop(item));
+}
+
+void test_spsc_ring_counts_drops_when_full() {
+    SpscRing<Item, 4> small;
+    Item item = {0, 0, 0};
+    for (uint32_t n = 0; n < 4; n++) {
+        item.seq = n;
+        TEST_ASSERT_TRUE(small.push(item));
+    }
+    TEST_ASSERT_FALSE(small.push(item));
+    TEST_ASSERT_FALSE(small.push(item));
+    TEST_ASSERT_EQUAL_UINT32(2, small.dropped());
+    TEST_ASSERT_TRUE(small.pop(item));
+    TEST_ASSERT_EQUAL_UINT32(0, item.seq);
+    TEST_ASSERT_TRUE(small.push(item));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_seqlock_never_tears);
+    RUN_TEST(test_spsc_ring_hands_over_in_order);
+    RUN_TEST(test_spsc_ring_counts_drops_when_full);
+    return UNITY_END();
+}
@@ -0,0 +1,194 @@
+// Status encodings against golden output. The dashboard's decodeFrame()
+// reads StatusFrame at fixed little-endian offsets and its JSON handler
+// expects the sketch's field names, so both are pinned byte for byte. The
+// benchmark reports encodes per second and checks that neither path
+// allocates.
+#include <unity.h>
+#include <chrono>
+#include <math.h>
+#include <new>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "json_writer.h"
+#include "status_frame.h"
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// The sketch's status values, as makeStatusFrame() and sendStatus() see them
+struct Status {
+    uint32_t seq;
+    float flow, volume, target;
+    uint32_t elapsed, uptime;
+    bool relay, valve, targetReached;
+    float jitterUs, overshootL;
+};
+
+static const Status STATUS = {0x01020304, 12.5f, 250.75f, 1000.0f, 3723, 86400, true, false, true, 3.21f, -0.0125f};
+
+static StatusFrame makeFrame(const Status &s) {
+    StatusFrame f;
+    f.version = STATUS_FRAME_VERSION;
+    f.type = FRAME_STATUS;
+    f.flags = (s.relay ? STATUS_FLAG_RELAY : 0) | (s.valve ? STATUS_FLAG_VALVE : 0) |
+              (s.targetReached ? STATUS_FLAG_TARGET_REACHED : 0);
+    f.flow = s.flow;
+    f.volume = s.volume;
+    f.target = s.target;
+    f.elapsed = s.elapsed;
+    f.uptime = s.uptime;
+    f.seq = s.seq;
+    return f;
+}
+
+// Same fields, order and decimals as sendStatus() in src/main.cpp
+static void writeStatus(JsonWriter &json, const Status &s) {
+    json.beginObject();
+    json.string("type", "status");
+    json.integer("seq", s.seq);
+    json.number("flow", s.flow, 3);
+    json.number("vol", s.volume, 3);
+    json.number("target", s.target, 3);
+    json.integer("elapsed", s.elapsed);
+    json.boolean("targetReached", s.targetReached);
+    json.integer("uptime", s.uptime);
+    json.boolean("relay", s.relay);
+    json.boolean("valve", s.valve);
+    json.number("jitterUs", s.jitterUs, 1);
+    json.number("overshoot", s.overshootL, 4);
+    json.endObject();
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Offsets used by decodeFrame() in include/index_html.h
+void test_status_frame_offsets_match_decoder() {
+    TEST_ASSERT_EQUAL(27, sizeof(StatusFrame));
+    TEST_ASSERT_EQUAL(2, offsetof(StatusFrame, flags));
+    TEST_ASSERT_EQUAL(3, offsetof(StatusFrame, flow));
+    TEST_ASSERT_EQUAL(7, offsetof(StatusFrame, volume));
+    TEST_ASSERT_EQUAL(11, offsetof(StatusFrame, target));
+    TEST_ASSERT_EQUAL(15, offsetof(StatusFrame, elapsed));
+    TEST_ASSERT_EQUAL(19, offsetof(StatusFrame, uptime));
+    TEST_ASSERT_EQUAL(23, offsetof(StatusFrame, seq));
+}
+
+void test_status_frame_golden_bytes() {
+    static const uint8_t golden[27] = {
+        0x02, 0x01, 0x05,       // version 2, FRAME_STATUS, relay | targetReached
+        0x00, 0x00, 0x48, 0x41, // flow 12.5
+        0x00, 0xc0, 0x7a, 0x43, // volume 250.75
+        0x00, 0x00, 0x7a, 0x44, // target 1000
+        0x8b, 0x0e, 0x00, 0x00, // elapsed 3723
+        0x80, 0x51, 0x01, 0x00, // uptime 86400
+        0x04, 0x03, 0x02, 0x01, // seq 0x01020304
+    };
+    StatusFrame frame = makeFrame(STATUS);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(golden, (const uint8_t *)&frame, sizeof(golden));
+}
+
+void test_history_header_golden_bytes() {
+    static const uint8_t golden[14] = {
+        0x02, 0x03,             // version 2, FRAME_HISTORY
+        0x08, 0x07,             // count 1800
+        0x2c, 0x01,             // oldest 300
+        0xe8, 0x03, 0x00, 0x00, // periodMs 1000
+        0xfa, 0x00, 0x00, 0x00, // ageMs 250
+    };
+    HistoryHeader h = {STATUS_FRAME_VERSION, FRAME_HISTORY, 1800, 300, 1000, 250};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(golden, (const uint8_t *)&h, sizeof(golden));
+}
+
+void test_status_json_golden() {
+    char buffer[320];
+    JsonWriter json(buffer, sizeof(buffer));
+    writeStatus(json, STATUS);
+    TEST_ASSERT_TRUE(json.ok());
+    TEST_ASSERT_EQUAL_STRING("{\"type\":\"status\",\"seq\":16909060,\"flow\":12.500,\"vol\":250.750,"
+                             "\"target\":1000.000,\"elapsed\":3723,\"targetReached\":true,\"uptime\":86400,"
+                             "\"relay\":true,\"valve\":false,\"jitterUs\":3.2,\"overshoot\":-0.0125}",
+                             json.data());
+}
+
+void test_json_numbers() {
+    char buffer[160];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.number("round", 2.0006f, 3);
+    json.number("tiny", -0.0004f, 3);
+    json.number("neg", -1.5f, 1);
+    json.number("nan", NAN, 2);
+    json.number("inf", INFINITY, 2);
+    json.integer("min", INT64_MIN);
+    json.beginArray("a");
+    json.item(1.25f, 2);
+    json.item((int64_t)-7);
+    json.endArray();
+    json.endObject();
+    TEST_ASSERT_TRUE(json.ok());
+    TEST_ASSERT_EQUAL_STRING("{\"round\":2.001,\"tiny\":0.000,\"neg\":-1.5,\"nan\":null,\"inf\":null,"
+                             "\"min\":-9223372036854775808,\"a\":[1.25,-7]}",
+                             json.data());
+}
+
+// A message that does not fit fails rather than going out truncated
+void test_json_overflow_fails() {
+    char buffer[40];
+    JsonWriter json(buffer, sizeof(buffer));
+    writeStatus(json, STATUS);
+    TEST_ASSERT_FALSE(json.ok());
+}
+
+// Host timing only; what carries over is the absence of allocation
+void test_benchmark_encoders() {
+    const uint32_t n = 1000000;
+    char buffer[320];
+    Status s = STATUS;
+    volatile uint32_t sink = 0;
+    allocations = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; i++) {
+        s.seq = i;
+        s.flow = i * 0.001f;
+        JsonWriter json(buffer, sizeof(buffer));
+        writeStatus(json, s);
+        sink = sink + (uint32_t)json.ok();
+    }
+    double jsonS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < n; i++) {
+        s.seq = i;
+        StatusFrame f = makeFrame(s);
+        sink = sink + f.seq;
+    }
+    double frameS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    TEST_ASSERT_EQUAL(0, allocations);
+    char msg[96];
+    snprintf(msg, sizeof(msg), "JSON %.0f msg/s, binary %.0f frames/s, 0 allocations", n / jsonS, n / frameS);
+    TEST_MESSAGE(msg);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_status_frame_offsets_match_decoder);
+    RUN_TEST(test_status_frame_golden_bytes);
+    RUN_TEST(test_history_header_golden_bytes);
+    RUN_TEST(test_status_json_golden);
+    RUN_TEST(test_json_numbers);
+    RUN_TEST(test_json_overflow_fails);
+    RUN_TEST(test_benchmark_encoders);
+    return UNITY_END();
+}
@@ -9,8 +9,16 @@ const char INDEX_HTML[] PROGMEM = R"=====(
     <meta name="viewport" content="width=device-width, initial-scale=1.0">
     <meta name="theme-color" content="#0f172a">
     <title>Tecotrack | Flow Control</title>
-    <link href="https://fonts.googleapis.com/css2?family=Outfit:wght@300;400;600;800&display=swap" rel="stylesheet">
     <style>
+        /* Served by the device (embed_html.py); no internet needed. Until
+           it loads, or if the build has none, the system font is used. */
+        @font-face {
+            font-family: 'Outfit';
+            src: url('/outfit.woff2') format('woff2');
+            font-weight: 300 800;
+            font-display: swap;
+        }
+
         :root {
             --primary: #00f2fe;
             --secondary: #4facfe;
@@ -26,7 +34,7 @@ const char INDEX_HTML[] PROGMEM = R"=====(
             margin: 0;
             padding: 0;
             box-sizing: border-box;
-            font-family: 'Outfit', sans-serif;
+            font-family: 'Outfit', system-ui, -apple-system, 'Segoe UI', Roboto, sans-serif;
         }
 
         body {
@@ -238,6 +246,36 @@ const char INDEX_HTML[] PROGMEM = R"=====(
             color: var(--success);
         }
 
+        .scope-card {
+            grid-column: 1 / -1;
+            text-align: left;
+        }
+
+        .scope-head {
+            display: flex;
+            justify-content: space-between;
+            align-items: center;
+            margin-bottom: 1rem;
+        }
+
+        .scope-head .btn {
+            padding: 0.5rem 1rem;
+            font-size: 0.8rem;
+        }
+
+        #scope-canvas, #trend-canvas {
+            width: 100%;
+            height: 220px;
+            background: rgba(0, 0, 0, 0.3);
+            border-radius: 12px;
+        }
+
+        .scope-legend {
+            margin-top: 0.8rem;
+            font-size: 0.85rem;
+            color: #94a3b8;
+        }
+
         #bg-canvas {
             position: absolute;
             top: 0;
@@ -355,107 +393,385 @@ const char INDEX_HTML[] PROGMEM = R"=====(
                 </div>
             </div>
         </div>
+
+        <!-- Trend Card -->
+        <div class="card scope-card">
+            <div class="scope-head">
+                <h3 style="color: var(--primary);">Trend</h3>
+            </div>
+            <canvas id="trend-canvas"></canvas>
+            <div class="scope-legend">
+                <span style="color: var(--primary);">Flow</span> (L/min) / <span style="color: var(--success);">Volume</span> (L), last 30 min
+            </div>
+        </div>
+
+        <!-- Diagnostics Card -->
+        <div class="card scope-card">
+            <div class="scope-head">
+                <h3 style="color: var(--primary);">Signal Scope</h3>
+                <button id="scope-btn" class="btn btn-toggle" onclick="toggleScope()">Scope</button>
+            </div>
+            <canvas id="scope-canvas"></canvas>
+            <div class="scope-legend">
+                <span style="color: var(--warning);">Raw</span> / <span style="color: var(--primary);">Filtered</span> (L/min)
+                <span id="scope-info"></span>
+            </div>
+        </div>
     </div>
 
     <script>
         let socket;
         let start = Date.now();
+        let lastSeq = null; // Highest message number seen, for resume after a reconnect
+
+        // User commands carry a request id ("#<id> <command>"); the device
+        // acks or nacks each one, so they can be pipelined and timed
+        let nextId = 1;
+        const pending = new Map(); // id -> { cmd, sentAt }
+
+        function sendCommand(cmd) {
+            if (socket.readyState !== WebSocket.OPEN) return;
+            const id = nextId++;
+            pending.set(id, { cmd: cmd, sentAt: performance.now() });
+            socket.send(`#${id} ${cmd}`);
+        }
+
+        function handleReply(data) {
+            const req = pending.get(data.id);
+            if (!req) return;
+            pending.delete(data.id);
+            const rtt = performance.now() - req.sentAt;
+            const status = document.getElementById('ws-status');
+            status.innerText = `Connected · ${rtt.toFixed(0)} ms`;
+            status.title = `Round trip ${rtt.toFixed(1)} ms, device ${(data.us / 1000).toFixed(2)} ms`;
+            if (data.type === 'nack') alert(`${req.cmd} refused: ${data.reason}`);
+        }
+
+        function noteSeq(seq) {
+            if (lastSeq === null || ((seq - lastSeq) | 0) > 0) lastSeq = seq;
+        }
+
+        // Async builds serve the WebSocket at /ws on the page's own port, the
+        // others on port 81. Each is tried in turn until one opens, then that
+        // one is kept; /ws first, since a firewalled port 81 only times out.
+        const wsUrls = [`ws://${window.location.host}/ws`, `ws://${window.location.hostname}:81`];
+        let wsUrl = 0, wsOpened = false;
 
         function connectWS() {
-            socket = new WebSocket(`ws://${window.location.hostname}:81`);
+            socket = new WebSocket(wsUrls[wsUrl]);
+            socket.binaryType = 'arraybuffer';
             
             socket.onopen = () => {
+                wsOpened = true;
                 const status = document.getElementById('ws-status');
                 status.innerText = "Connected";
                 status.classList.add('connected');
+                // One frame, one command per line
+                const setup = [
+                    'format:bin',            // Status as binary frames from here on
+                    'subscribe:status@20Hz', // Live gauges; frames carry the flow
+                    'history'                // Trend of the last half hour, as one binary message
+                ];
+                scopeSeq = -1;
+                if (scopeOn) setup.push('subscribe:scope');
+                if (lastSeq !== null) setup.push('resume:' + lastSeq); // Missed events, then fresh state
+                socket.send(setup.join('\n'));
             };
 
             socket.onclose = () => {
                 const status = document.getElementById('ws-status');
                 status.innerText = "Disconnected";
                 status.classList.remove('connected');
+                pending.clear();
+                liveFlow = liveVol = NaN; // The trend pauses until the history is resent
+                if (!wsOpened) {
+                    wsUrl = (wsUrl + 1) % wsUrls.length;
+                    if (wsUrl !== 0) return connectWS(); // Next address at once
+                }
                 setTimeout(connectWS, 2000);
             };
 
             socket.onmessage = (event) => {
-                const data = JSON.parse(event.data);
-                
-                if (data.type === 'flow') {
-                    const val = data.val.toFixed(1);
-                    document.getElementById('flow-val').innerText = val;
-                    const offset = 440 - (440 * Math.min(val, 100) / 100);
-                    document.getElementById('flow-bar').style.strokeDashoffset = offset;
-                } 
-                else if (data.type === 'volumeUpdate') {
-                    document.getElementById('vol-val').innerText = data.vol.toFixed(2);
-                    document.getElementById('vol-target-display').innerText = Math.round(data.target);
-                    
-                    const s = data.elapsed;
-                    const h = Math.floor(s / 3600).toString().padStart(2, '0');
-                    const m = Math.floor((s % 3600) / 60).toString().padStart(2, '0');
-                    const sec = (s % 60).toString().padStart(2, '0');
-                    document.getElementById('session-time').innerText = `${h}:${m}:${sec}`;
-                    
-                    const statusEl = document.getElementById('batch-status');
-                    const mainBtn = document.getElementById('main-btn');
-                    const volInput = document.getElementById('vol-input');
-                    const resetBtn = document.querySelector('.btn-danger');
-
-                    // Update Relay UI state
-                    if (data.relayActive) {
-                        mainBtn.classList.add('active');
-                        mainBtn.innerText = "Pause Batch";
-                        volInput.disabled = true;
-                        volInput.style.opacity = "0.5";
-                        resetBtn.disabled = true;
-                        resetBtn.style.opacity = "0.5";
-                    } else {
-                        mainBtn.classList.remove('active');
-                        mainBtn.innerText = "Start Batch";
-                        volInput.disabled = false;
-                        volInput.style.opacity = "1";
-                        resetBtn.disabled = false;
-                        resetBtn.style.opacity = "1";
-                    }
-
-                    // Update Valve UI state
-                    const valveBtn = document.getElementById('valve-btn');
-                    if (data.valveActive) valveBtn.classList.add('active');
-                    else valveBtn.classList.remove('active');
-
-                    if (data.targetReached) {
-                        statusEl.innerText = "COMPLETED";
-                        statusEl.style.color = "var(--danger)";
-                        document.getElementById('batch-progress').style.background = "var(--danger)";
-                    } else if (data.relayActive) {
-                        statusEl.innerText = "RUNNING";
-                        statusEl.style.color = "var(--success)";
-                        document.getElementById('batch-progress').style.background = "linear-gradient(to right, var(--primary), var(--secondary))";
-                    } else {
-                        statusEl.innerText = "Stopped";
-                        statusEl.style.color = "var(--warning)";
-                        document.getElementById('batch-progress').style.background = "var(--warning)";
-                    }
-
-                    const pct = Math.min((data.vol / data.target) * 100, 100);
-                    document.getElementById('batch-progress').style.width = `${pct}%`;
-
-                    // Update Device Uptime
-                    const upSec = data.uptime;
-                    const upH = Math.floor(upSec / 3600);
-                    const upM = Math.floor((upSec % 3600) / 60);
-                    const upS = upSec % 60;
-                    let upStr = "";
-                    if (upH > 0) upStr += upH + "h ";
-                    if (upM > 0 || upH > 0) upStr += upM + "m ";
-                    upStr += upS + "s";
-                    document.getElementById('uptime').innerText = upStr;
+                if (typeof event.data === 'string') handleMessage(JSON.parse(event.data));
+                else decodeFrame(event.data).forEach(handleMessage);
+            };
+        }
+
+        // Binary status frame (status_frame.h), little-endian:
+        // u8 version, u8 type, u8 flags, f32 flow, f32 vol, f32 target, u32 elapsed, u32 uptime, u32 seq
+        // Carries both the 'flow' and the 'volumeUpdate' message.
+        function decodeFrame(buf) {
+            const v = new DataView(buf);
+            if (v.byteLength < 2 || v.getUint8(0) !== 2) return [];
+            if (v.getUint8(1) === 2) {
+                addScopeChunk(v);
+                return [];
+            }
+            if (v.getUint8(1) === 3) {
+                loadHistory(v);
+                return [];
+            }
+            if (v.byteLength < 27 || v.getUint8(1) !== 1) return [];
+            const flags = v.getUint8(2);
+            const seq = v.getUint32(23, true);
+            return [
+                { type: 'flow', val: v.getFloat32(3, true), seq: seq },
+                {
+                    type: 'volumeUpdate',
+                    relayActive: (flags & 0x01) !== 0,
+                    valveActive: (flags & 0x02) !== 0,
+                    targetReached: (flags & 0x04) !== 0,
+                    vol: v.getFloat32(7, true),
+                    target: v.getFloat32(11, true),
+                    elapsed: v.getUint32(15, true),
+                    uptime: v.getUint32(19, true),
+                    seq: seq
+                }
+            ];
+        }
+
+        // Trend: flow and volume once a second for the last half hour. The
+        // device's history fills it on connect, then it takes one point a
+        // second from the live status. History message (status_frame.h):
+        // u8 version, u8 type, u16 count, u16 oldest, u32 periodMs, u32 ageMs,
+        // then count x {u16 flow * 100, f32 vol}, oldest at index `oldest`
+        const TREND_POINTS = 1800;
+        const trendFlow = new Float32Array(TREND_POINTS).fill(NaN);
+        const trendVol = new Float32Array(TREND_POINTS).fill(NaN);
+        let trendHead = 0, liveFlow = NaN, liveVol = NaN;
+
+        function trendPush(flow, vol) {
+            trendFlow[trendHead] = flow;
+            trendVol[trendHead] = vol;
+            trendHead = (trendHead + 1) % TREND_POINTS;
+        }
+
+        function loadHistory(v) {
+            if (v.byteLength < 14) return;
+            const count = v.getUint16(2, true), oldest = v.getUint16(4, true);
+            if (v.byteLength < 14 + count * 6) return;
+            trendFlow.fill(NaN);
+            trendVol.fill(NaN);
+            trendHead = 0;
+            for (let i = 0; i < count; i++) {
+                const at = 14 + ((oldest + i) % count) * 6;
+                trendPush(v.getUint16(at, true) / 100, v.getFloat32(at + 2, true));
+            }
+            drawTrend();
+        }
+
+        setInterval(() => {
+            if (!isFinite(liveFlow) || !isFinite(liveVol)) return;
+            trendPush(liveFlow, liveVol);
+            drawTrend();
+        }, 1000);
+
+        function drawTrend() {
+            const c = document.getElementById('trend-canvas');
+            const tctx = c.getContext('2d');
+            const dpr = window.devicePixelRatio || 1;
+            const cw = c.width = c.clientWidth * dpr;
+            const ch = c.height = c.clientHeight * dpr;
+
+            // Each series on its own scale
+            const trace = (data, color) => {
+                let lo = Infinity, hi = -Infinity;
+                data.forEach(y => {
+                    if (isFinite(y)) { lo = Math.min(lo, y); hi = Math.max(hi, y); }
+                });
+                if (lo > hi) return;
+                const pad = (hi - lo) * 0.1 || 1;
+                lo -= pad;
+                hi += pad;
+                tctx.strokeStyle = color;
+                tctx.lineWidth = dpr;
+                tctx.beginPath();
+                let pen = false;
+                for (let i = 0; i < TREND_POINTS; i++) {
+                    const y = data[(trendHead + i) % TREND_POINTS]; // Oldest first
+                    if (!isFinite(y)) { pen = false; continue; }
+                    const px = i * cw / (TREND_POINTS - 1);
+                    const py = ch - (y - lo) * ch / (hi - lo);
+                    if (pen) tctx.lineTo(px, py); else tctx.moveTo(px, py);
+                    pen = true;
                 }
+                tctx.stroke();
             };
+            trace(trendVol, '#22c55e');
+            trace(trendFlow, '#00f2fe');
+        }
+
+        // Diagnostic scope: the flow filter's input (raw) and output at the
+        // control rate. Chunk frame (status_frame.h): u8 version, u8 type,
+        // u16 count, u32 seq, u32 periodUs, then count x {f32 raw, f32 filtered}
+        const SCOPE_POINTS = 600;
+        const scopeRaw = new Float32Array(SCOPE_POINTS).fill(NaN);
+        const scopeFilt = new Float32Array(SCOPE_POINTS).fill(NaN);
+        let scopeHead = 0, scopeSeq = -1, scopeDropped = 0, scopePeriodUs = 0;
+        let scopeOn = false, scopeDrawPending = false;
+
+        function toggleScope() {
+            scopeOn = !scopeOn;
+            scopeSeq = -1;
+            document.getElementById('scope-btn').classList.toggle('active', scopeOn);
+            if (socket.readyState === WebSocket.OPEN) socket.send(scopeOn ? 'subscribe:scope' : 'unsubscribe:scope');
+        }
+
+        function scopePush(raw, filt) {
+            scopeRaw[scopeHead] = raw;
+            scopeFilt[scopeHead] = filt;
+            scopeHead = (scopeHead + 1) % SCOPE_POINTS;
+        }
+
+        function addScopeChunk(v) {
+            if (v.byteLength < 12) return;
+            const count = v.getUint16(2, true), seq = v.getUint32(4, true);
+            if (v.byteLength < 12 + count * 8) return;
+            if (scopeSeq >= 0 && seq !== ((scopeSeq + 1) >>> 0)) {
+                // The device dropped whole chunks: count them and break the trace
+                scopeDropped += (seq - scopeSeq - 1) >>> 0;
+                scopePush(NaN, NaN);
+            }
+            scopeSeq = seq;
+            scopePeriodUs = v.getUint32(8, true);
+            for (let i = 0; i < count; i++) {
+                scopePush(v.getFloat32(12 + i * 8, true), v.getFloat32(16 + i * 8, true));
+            }
+            if (!scopeDrawPending) {
+                scopeDrawPending = true;
+                requestAnimationFrame(drawScope);
+            }
+        }
+
+        function drawScope() {
+            scopeDrawPending = false;
+            const c = document.getElementById('scope-canvas');
+            const sctx = c.getContext('2d');
+            const dpr = window.devicePixelRatio || 1;
+            const cw = c.width = c.clientWidth * dpr;
+            const ch = c.height = c.clientHeight * dpr;
+
+            let lo = Infinity, hi = -Infinity;
+            [scopeRaw, scopeFilt].forEach(data => data.forEach(y => {
+                if (isFinite(y)) { lo = Math.min(lo, y); hi = Math.max(hi, y); }
+            }));
+            if (lo > hi) return;
+            const pad = (hi - lo) * 0.1 || 1;
+            lo -= pad;
+            hi += pad;
+
+            const trace = (data, color) => {
+                sctx.strokeStyle = color;
+                sctx.lineWidth = dpr;
+                sctx.beginPath();
+                let pen = false;
+                for (let i = 0; i < SCOPE_POINTS; i++) {
+                    const y = data[(scopeHead + i) % SCOPE_POINTS]; // Oldest first
+                    if (!isFinite(y)) { pen = false; continue; }
+                    const px = i * cw / (SCOPE_POINTS - 1);
+                    const py = ch - (y - lo) * ch / (hi - lo);
+                    if (pen) sctx.lineTo(px, py); else sctx.moveTo(px, py);
+                    pen = true;
+                }
+                sctx.stroke();
+            };
+            trace(scopeRaw, '#f59e0b');
+            trace(scopeFilt, '#00f2fe');
+
+            const rate = scopePeriodUs ? Math.round(1e6 / scopePeriodUs) : 0;
+            document.getElementById('scope-info').innerText =
+                ` | ${rate} Hz, ${lo.toFixed(2)} to ${hi.toFixed(2)}, ${scopeDropped} chunks dropped`;
+        }
+
+        // Status only arrives on change, so uptime ticks locally in between
+        let uptimeSec = 0, uptimeAt = Date.now();
+        function renderUptime() {
+            const upSec = uptimeSec + Math.floor((Date.now() - uptimeAt) / 1000);
+            const upH = Math.floor(upSec / 3600);
+            const upM = Math.floor((upSec % 3600) / 60);
+            const upS = upSec % 60;
+            let upStr = "";
+            if (upH > 0) upStr += upH + "h ";
+            if (upM > 0 || upH > 0) upStr += upM + "m ";
+            upStr += upS + "s";
+            document.getElementById('uptime').innerText = upStr;
+        }
+        setInterval(renderUptime, 1000);
+
+        function handleMessage(data) {
+            if (data.seq !== undefined) noteSeq(data.seq);
+            if (data.type === 'ack' || data.type === 'nack') return handleReply(data);
+            if (data.type === 'flow') {
+                liveFlow = data.val;
+                const val = data.val.toFixed(1);
+                document.getElementById('flow-val').innerText = val;
+                const offset = 440 - (440 * Math.min(val, 100) / 100);
+                document.getElementById('flow-bar').style.strokeDashoffset = offset;
+            } 
+            else if (data.type === 'volumeUpdate') {
+                liveVol = data.vol;
+                document.getElementById('vol-val').innerText = data.vol.toFixed(2);
+                document.getElementById('vol-target-display').innerText = Math.round(data.target);
+                
+                const s = data.elapsed;
+                const h = Math.floor(s / 3600).toString().padStart(2, '0');
+                const m = Math.floor((s % 3600) / 60).toString().padStart(2, '0');
+                const sec = (s % 60).toString().padStart(2, '0');
+                document.getElementById('session-time').innerText = `${h}:${m}:${sec}`;
+                
+                const statusEl = document.getElementById('batch-status');
+                const mainBtn = document.getElementById('main-btn');
+                const volInput = document.getElementById('vol-input');
+                const resetBtn = document.querySelector('.btn-danger');
+
+                // Update Relay UI state
+                if (data.relayActive) {
+                    mainBtn.classList.add('active');
+                    mainBtn.innerText = "Pause Batch";
+                    volInput.disabled = true;
+                    volInput.style.opacity = "0.5";
+                    resetBtn.disabled = true;
+                    resetBtn.style.opacity = "0.5";
+                } else {
+                    mainBtn.classList.remove('active');
+                    mainBtn.innerText = "Start Batch";
+                    volInput.disabled = false;
+                    volInput.style.opacity = "1";
+                    resetBtn.disabled = false;
+                    resetBtn.style.opacity = "1";
+                }
+
+                // Update Valve UI state
+                const valveBtn = document.getElementById('valve-btn');
+                if (data.valveActive) valveBtn.classList.add('active');
+                else valveBtn.classList.remove('active');
+
+                if (data.targetReached) {
+                    statusEl.innerText = "COMPLETED";
+                    statusEl.style.color = "var(--danger)";
+                    document.getElementById('batch-progress').style.background = "var(--danger)";
+                } else if (data.relayActive) {
+                    statusEl.innerText = "RUNNING";
+                    statusEl.style.color = "var(--success)";
+                    document.getElementById('batch-progress').style.background = "linear-gradient(to right, var(--primary), var(--secondary))";
+                } else {
+                    statusEl.innerText = "Stopped";
+                    statusEl.style.color = "var(--warning)";
+                    document.getElementById('batch-progress').style.background = "var(--warning)";
+                }
+
+                const pct = Math.min((data.vol / data.target) * 100, 100);
+                document.getElementById('batch-progress').style.width = `${pct}%`;
+
+                // Update Device Uptime
+                uptimeSec = data.uptime;
+                uptimeAt = Date.now();
+                renderUptime();
+            }
         }
 
         function togglePin(pin) {
-            if (socket.readyState === WebSocket.OPEN) socket.send(`toggle:${pin}`);
+            sendCommand(`toggle:${pin}`);
         }
 
         function setTarget() {
@@ -467,13 +783,11 @@ const char INDEX_HTML[] PROGMEM = R"=====(
                 return;
             }
 
-            if (socket.readyState === WebSocket.OPEN) socket.send(`setTarget:${val}`);
+            sendCommand(`setTarget:${val}`);
         }
 
         function resetBatch() {
-            if (confirm("Reset current batch data?") && socket.readyState === WebSocket.OPEN) {
-                socket.send("resetBatch");
-            }
+            if (confirm("Reset current batch data?")) sendCommand("resetBatch");
         }
 
         // Background particles
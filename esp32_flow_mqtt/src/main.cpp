@@ -1,14 +1,41 @@
 #include <WiFi.h>
-#include <WebServer.h>
-#include <WebSocketsServer.h>
+#include "http_server.h"
 #include <ArduinoJson.h>
 #include <Preferences.h>
 #include <esp_task_wdt.h>
+#include <atomic>
 #include <WiFiClientSecure.h>
 #include <PubSubClient.h>
 #include <esp_wifi.h>
 #include <DNSServer.h>
 #include "index_html.h"
+#if __has_include("index_html_gz.h")
+#include "index_html_gz.h"
+#endif
+#if __has_include("font_woff2.h")
+#include "font_woff2.h"
+#endif
+#include "flow_sampler.h"
+#include "flow_adc.h"
+#include "flow_pulse.h"
+#include "kalman_filter.h"
+#include "flow_totalizer.h"
+#include "seqlock.h"
+#include "batch_cutoff.h"
+#include "flow_calibration.h"
+#include "flow_channels.h"
+#include "spsc_ring.h"
+#include "status_frame.h"
+#include "report_by_exception.h"
+#include "json_writer.h"
+#include "client_subscriptions.h"
+#include "command_parser.h"
+#include "scope_capture.h"
+#include "client_send_queue.h"
+#include "event_log.h"
+#include "ws_server.h"
+#include "history_ring.h"
+#include "asset_store.h"
 #include "secrets.h"
 
 #define FIRMWARE_VERSION "2.1.0"
@@ -18,29 +45,82 @@
 #define RELAY_PIN 13
 #define VALVE_PIN 16
 #define WDT_TIMEOUT 60 
+#ifndef SAMPLE_RATE_HZ
+#define SAMPLE_RATE_HZ 10 // Control loop rate, 10 Hz .. 1 kHz
+#endif
+
+// Flow input acquisition
+#define FLOW_INPUT_ANALOG 0  // One blocking analogRead() per tick
+#define FLOW_INPUT_ADC_DMA 1 // Continuous DMA sampling, decimated per tick
+#define FLOW_INPUT_PULSE 2   // Pulse-output meter on FLOW_SENSOR_PIN, counted by PCNT
+#ifndef FLOW_INPUT_MODE
+#define FLOW_INPUT_MODE FLOW_INPUT_ADC_DMA
+#endif
+#ifndef PULSE_K_FACTOR
+#define PULSE_K_FACTOR 100.0f // Meter pulses per litre
+#endif
+#ifndef PULSE_FILTER_NS
+#define PULSE_FILTER_NS 10000 // Glitch filter; keep well under half the fastest pulse period
+#endif
+
+// Multi-line metering: FLOW_CHANNELS > 1 replaces the single sensor/pump
+// controller with a bank of independent channels (flow_channels.h).
+// Channel i reads CHANNEL_SENSOR_PINS[i] and drives CHANNEL_RELAY_PINS[i];
+// the valve stays shared. Sensors must sit on ADC1 (ADC2 is unusable while
+// WiFi runs); the nodemcu-32s breaks out the first six listed.
+#ifndef FLOW_CHANNELS
+#define FLOW_CHANNELS 1
+#endif
+#if FLOW_CHANNELS > 1
+const uint8_t CHANNEL_SENSOR_PINS[FLOW_MAX_CHANNELS] = { 34, 35, 32, 33, 36, 39, 37, 38 };
+const uint8_t CHANNEL_RELAY_PINS[FLOW_MAX_CHANNELS] = { 13, 14, 27, 26, 25, 23, 22, 21 };
+#endif
 
 // Network Globals
 const char* ssid = "roku";
 const char* password = "Linux.456";
 
+// Storing UI files over HTTP (POST/DELETE /assets) is compiled in only
+// when a password is set, in secrets.h or build_flags =
+// '-DASSET_UPLOAD_PASSWORD="..."'; those requests then need
+// HTTP authentication. Files put on LittleFS with uploadfs are served
+// either way.
+#ifndef ASSET_UPLOAD_USER
+#define ASSET_UPLOAD_USER "admin"
+#endif
+
 WiFiClient net;
 PubSubClient client(net);
 String mqttPubTopic;
 String mqttClientId;
 String mqttSubTopic;
 String mqttCompletedTopic;
-bool pendingCompletionMqtt = false;
 bool isAPMode = false;
 
 // Global Objects
-WebServer server(80);
-WebSocketsServer webSocket(81);
+// Web transport (http_server.h): build with -DWEB_SERVER_ASYNC=1
+// (env:nodemcu-32s-async) to serve the page and the WebSocket together on
+// port 80 from the TCP stack's callbacks instead of polling in loop()
+FlowWebServer server(80);
+#if WEB_SERVER_ASYNC
+FlowWebSocketsServer webSocket(server.async(), "/ws");
+#else
+FlowWebSocketsServer webSocket(81);
+#endif
 DNSServer dnsServer;
 Preferences preferences;
+AssetStore assets; // Uploaded UI files, ahead of the compiled-in page
+FlowSampler sampler;
+AdcOversampler flowAdc;
+PulseCounter flowPulses;
+BatchCutoff cutoff;
+#if FLOW_CHANNELS == 1
+ScopeCapture scope; // Diagnostic waveform, only while a client watches
+#endif
 
-// Volatile System State
+// System State (owned by flowControlTask; other tasks read statusSnapshot)
 struct SystemState {
-    float accumulatedVolume = 0;
+    FlowTotalizer volume; // Exact batch volume in micro-litres
     float currentFlow = 0;
     float volumeTarget = 1000.0;
     bool relayActive = false;
@@ -55,148 +135,1272 @@ struct SystemState {
     unsigned long batchStartMillis = 0;
 } state;
 
-class KalmanFilter {
-    float _q, _r, _p, _x, _k;
-public:
-    KalmanFilter(float q, float r, float p, float initial) : _q(q), _r(r), _p(p), _x(initial) {}
-    float update(float measurement) {
-        _p = _p + _q;
-        _k = _p / (_p + _r);
-        _x = _x + _k * (measurement - _x);
-        _p = (1 - _k) * _p;
-        return _x;
-    }
-} flowFilter(0.01, 0.1, 1.0, 0.0);
+// Consistent copy of SystemState, published by the control task every tick
+struct StatusSnapshot {
+    int64_t volumeUl;
+    float volume;
+    float currentFlow;
+    float volumeTarget;
+    uint32_t sessionMs;
+    bool relayActive;
+    bool valveActive;
+    bool targetReached;
+    BatchCutoff::Stats cutoff;
+    time_t batchStartTime;
+    int pauseCount;
+    unsigned long batchStartMillis;
+};
+SeqLock<StatusSnapshot> statusSnapshot;
+
+#if FLOW_CHANNELS > 1
+FlowChannels<FLOW_CHANNELS> channels; // Owned by channelScanTask
+
+struct ChannelSnapshot {
+    int64_t volumeUl[FLOW_CHANNELS];
+    float flow[FLOW_CHANNELS];
+    float volume[FLOW_CHANNELS];
+    float target[FLOW_CHANNELS];
+    uint32_t runMs[FLOW_CHANNELS];
+    uint8_t relayMask;
+    uint8_t reachedMask;
+    bool valveActive;
+};
+SeqLock<ChannelSnapshot> channelSnapshot;
+#endif
+
+// Commands from WebSocket/MQTT, applied by the control task
+enum CommandType : uint8_t {
+    CMD_TOGGLE_RELAY,
+    CMD_SET_RELAY,
+    CMD_TOGGLE_VALVE,
+    CMD_SET_TARGET,
+    CMD_RESET_BATCH,
+    CMD_LOAD_CALIBRATION,
+    CMD_CHANNEL_TOGGLE,
+    CMD_CHANNEL_SET_RELAY,
+    CMD_CHANNEL_TARGET,
+    CMD_CHANNEL_RESET
+};
+
+struct Command {
+    CommandType type;
+    uint8_t channel; // CMD_CHANNEL_* only
+    uint16_t ticket; // Client request awaiting the outcome; 0: none
+    float value;
+};
+QueueHandle_t commandQueue;
+
+// Default sensor curve: linear 4-20 mA -> 0-100 L/min on the 12-bit ADC.
+// Per-device curves are stored in NVS under "calib".
+constexpr CalibPoint DEFAULT_CALIBRATION[] = {
+    { 744, 0.0f },    // 4 mA
+    { 3720, 100.0f }  // 20 mA
+};
+static_assert(calibValid(DEFAULT_CALIBRATION, 2), "Invalid default calibration");
+FlowCalibration<4096> calibration;
+
+// The curve in use, published by the control task on each load; loop()
+// persists it from EVT_CALIB_LOADED
+struct CalibrationSnapshot {
+    CalibPoint points[CALIB_MAX_POINTS];
+    uint8_t count;
+};
+SeqLock<CalibrationSnapshot> calibrationSnapshot;
+
+// Staging for CMD_LOAD_CALIBRATION; the table is owned by the control task
+CalibPoint pendingCalibration[CALIB_MAX_POINTS];
+uint8_t pendingCalibrationCount = 0;
+std::atomic<bool> calibrationPending(false);
+
+// Control task -> network side notifications. The control task never
+// touches the network, NVS or Serial; it pushes fixed-size events, loop()
+// reports, broadcasts and saves, and mqttTask publishes batch completions.
+// Each ring has exactly one consumer.
+enum EventType : uint8_t {
+    EVT_STATE_CHANGED,  // A command was applied
+    EVT_RELAY_CHANGED,  // code: 1 on, 0 off
+    EVT_BATCH_RESET,
+    EVT_TARGET_REACHED, // Pump cut at volumeUl
+    EVT_BATCH_SETTLED,  // Overshoot measured, see StatusSnapshot::cutoff
+    EVT_CALIB_LOADED,   // The staged curve is live, see calibrationSnapshot
+    EVT_FAULT,          // code: FaultCode
+    EVT_COMMAND_REFUSED // A ticketed command did not apply in the current state
+};
+
+enum FaultCode : uint8_t {
+    FAULT_SAMPLER_INIT,
+    FAULT_ADC_INIT,
+    FAULT_PULSE_INIT,
+    FAULT_TICK_TIMEOUT
+};
+
+struct ControlEvent {
+    int64_t volumeUl;
+    float flow;
+    uint32_t timeMs;
+    EventType type;
+    uint8_t code;
+    uint8_t channel;
+    uint16_t ticket; // The command that caused it, see Command
+};
+SpscRing<ControlEvent, 16> controlEvents; // Consumed by loop()
+SpscRing<ControlEvent, 8> mqttEvents;     // Consumed by mqttTask: completions only
+
+// A batch is complete once its final volume is known: after the settle
+// window on the single line, at the cut for bank channels
+#if FLOW_CHANNELS > 1
+#define EVT_BATCH_COMPLETED EVT_TARGET_REACHED
+#else
+#define EVT_BATCH_COMPLETED EVT_BATCH_SETTLED
+#endif
+
+void emitEvent(EventType type, uint8_t code = 0, uint8_t channel = 0, int64_t volumeUl = 0, float flow = 0,
+               uint16_t ticket = 0) {
+    ControlEvent ev = { volumeUl, flow, (uint32_t)millis(), type, code, channel, ticket };
+    controlEvents.push(ev);
+    if (type == EVT_BATCH_COMPLETED) mqttEvents.push(ev);
+}
+
+KalmanFilter<float> flowFilter(0.01, 0.1, 1.0, 0.0);
 
 void broadcastStatus();
 void saveVolumeToNVS();
+#if FLOW_CHANNELS > 1
+void publishChannels();
+#endif
 void connectToMQTT();
 void mqttTask(void * pvParameters);
 void syncTime();
 
 // --- CORE 1: High Priority Flow Integration Task ---
+void publishSnapshot() {
+    StatusSnapshot s;
+    s.volumeUl = state.volume.microLitres();
+    s.volume = state.volume.litres();
+    s.currentFlow = state.currentFlow;
+    s.volumeTarget = state.volumeTarget;
+    s.sessionMs = state.accumulatedTimeMs;
+    if (state.relayActive) s.sessionMs += (millis() - state.relayStartTime);
+    s.relayActive = state.relayActive;
+    s.valveActive = state.valveActive;
+    s.targetReached = state.targetReached;
+    s.cutoff = cutoff.stats();
+    s.batchStartTime = state.batchStartTime;
+    s.pauseCount = state.pauseCount;
+    s.batchStartMillis = state.batchStartMillis;
+    statusSnapshot.write(s);
+}
+
+// Returns false if the relay was already in that state
+bool setRelay(bool on) {
+    if (on == state.relayActive) return false;
+    cutoff.cancel();
+    state.relayActive = on;
+    digitalWrite(RELAY_PIN, state.relayActive ? HIGH : LOW);
+
+    if (state.relayActive) {
+        bool isNewBatch = (state.volume.microLitres() <= 10000 || state.targetReached);
+        if (state.targetReached) {
+            state.volume.reset();
+            state.accumulatedTimeMs = 0;
+            state.targetReached = false;
+        }
+        if (isNewBatch) {
+            state.batchStartTime = time(nullptr);
+            state.batchStartMillis = millis();
+            state.pauseCount = 0;
+        }
+        state.relayStartTime = millis();
+    } else {
+        state.accumulatedTimeMs += (millis() - state.relayStartTime);
+        state.pauseCount++;
+    }
+    return true;
+}
+
+// Safety rules are re-checked here: the sender validated against a
+// snapshot that may be a tick old. False when the command does not apply.
+bool applyCommand(const Command &cmd) {
+#if FLOW_CHANNELS > 1
+    // Channel 0 owns RELAY_PIN; the single-line batch commands would fight it
+    if (cmd.type == CMD_TOGGLE_RELAY || cmd.type == CMD_SET_RELAY ||
+        cmd.type == CMD_SET_TARGET || cmd.type == CMD_RESET_BATCH) return false;
+#endif
+    EventType event = EVT_STATE_CHANGED;
+    uint8_t code = 0;
+    switch (cmd.type) {
+        case CMD_TOGGLE_RELAY:
+        case CMD_SET_RELAY:
+            if (!setRelay(cmd.type == CMD_SET_RELAY ? cmd.value != 0 : !state.relayActive)) return false;
+            event = EVT_RELAY_CHANGED;
+            code = state.relayActive;
+            break;
+        case CMD_TOGGLE_VALVE:
+            state.valveActive = !state.valveActive;
+            digitalWrite(VALVE_PIN, state.valveActive ? HIGH : LOW);
+            break;
+        case CMD_SET_TARGET:
+            if (state.relayActive) return false;
+            if (FlowTotalizer::fromLitres(cmd.value) <= state.volume.microLitres()) return false;
+            state.volumeTarget = cmd.value;
+            state.targetReached = false;
+            break;
+        case CMD_RESET_BATCH:
+            if (state.relayActive) return false;
+            cutoff.cancel();
+            state.volume.reset();
+            state.accumulatedTimeMs = 0;
+            state.targetReached = false;
+            event = EVT_BATCH_RESET;
+            break;
+        case CMD_LOAD_CALIBRATION: {
+            calibration.load(pendingCalibration, pendingCalibrationCount);
+            calibrationPending = false;
+            CalibrationSnapshot c;
+            memcpy(c.points, calibration.points(), sizeof(c.points));
+            c.count = calibration.count();
+            calibrationSnapshot.write(c);
+            event = EVT_CALIB_LOADED;
+            break;
+        }
+#if FLOW_CHANNELS > 1
+        case CMD_CHANNEL_TOGGLE:
+        case CMD_CHANNEL_SET_RELAY: {
+            bool on = cmd.type == CMD_CHANNEL_SET_RELAY ? cmd.value != 0
+                                                        : !(channels.relayMask() & (1u << cmd.channel));
+            if (!channels.setRelay(cmd.channel, on)) return false;
+            event = EVT_RELAY_CHANGED;
+            code = on;
+            break;
+        }
+        case CMD_CHANNEL_TARGET:
+            if (!channels.setTarget(cmd.channel, cmd.value)) return false;
+            break;
+        case CMD_CHANNEL_RESET:
+            if (!channels.reset(cmd.channel)) return false;
+            event = EVT_BATCH_RESET;
+            break;
+#else
+        default:
+            return false;
+#endif
+    }
+    // Publish first so the event's consumers see the new state
+#if FLOW_CHANNELS > 1
+    publishChannels();
+#else
+    publishSnapshot();
+#endif
+    emitEvent(event, code, cmd.channel, 0, 0, cmd.ticket);
+    return true;
+}
+
+bool sendCommand(CommandType type, float value = 0, uint8_t channel = 0, uint16_t ticket = 0) {
+    Command cmd = { type, channel, ticket, value };
+    return xQueueSend(commandQueue, &cmd, 0) == pdTRUE;
+}
+
+// Stages a new curve for the control task. Safe from any network task:
+// the first caller claims the staging buffer until the curve is loaded.
+bool setCalibration(const CalibPoint *points, uint8_t count, uint16_t ticket = 0) {
+    bool idle = false;
+    if (!calibValid(points, count) || !calibrationPending.compare_exchange_strong(idle, true)) return false;
+    memcpy(pendingCalibration, points, count * sizeof(CalibPoint));
+    pendingCalibrationCount = count;
+    if (!sendCommand(CMD_LOAD_CALIBRATION, 0, 0, ticket)) {
+        calibrationPending = false;
+        return false;
+    }
+    return true;
+}
+
+// The command table (COMMANDS, CommandOp); after FLOW_CHANNELS, which
+// selects the batch or per-channel commands
+#include "flow_commands.h"
+
+// Applies a parsed device command. Safe from any task: it only reads the
+// snapshots and queues work for the control task, which does the channel
+// checks. Returns why the command was refused, or nullptr. `queued` says
+// the control task still has to apply it; it reports the outcome as an
+// event carrying `ticket`.
+const char *runCommand(const ParsedCommand &cmd, uint16_t ticket, bool &queued) {
+    const CommandArg *arg = cmd.args;
+    queued = false;
+    auto send = [ticket, &queued](CommandType type, float value, uint8_t channel) -> const char * {
+        if (!sendCommand(type, value, channel, ticket)) return "busy";
+        queued = true;
+        return nullptr;
+    };
+    switch (cmd.spec->id) {
+        case OP_TOGGLE:
+#if FLOW_CHANNELS == 1
+            if (arg[0].i == RELAY_PIN) return send(CMD_TOGGLE_RELAY, 0, 0);
+#endif
+            if (arg[0].i == VALVE_PIN) return send(CMD_TOGGLE_VALVE, 0, 0);
+            return "no such output";
+#if FLOW_CHANNELS == 1
+        case OP_SET_RELAY:
+            if ((arg[0].i != 0) == statusSnapshot.read().relayActive) return nullptr; // Already there
+            return send(CMD_SET_RELAY, arg[0].i, 0);
+        case OP_SET_TARGET: {
+            StatusSnapshot s = statusSnapshot.read();
+            // Safety Rule 1: Don't allow changes while running
+            if (s.relayActive) return "running";
+            // Safety Rule 2: New target must be greater than current volume
+            if (FlowTotalizer::fromLitres(arg[0].f) <= s.volumeUl) return "target not above volume";
+            const char *refused = send(CMD_SET_TARGET, arg[0].f, 0);
+            if (!refused) Serial.printf("[SYSTEM] Target change to %.1f L requested\n", arg[0].f);
+            return refused;
+        }
+        case OP_RESET_BATCH:
+            if (statusSnapshot.read().relayActive) return "running";
+            return send(CMD_RESET_BATCH, 0, 0);
+#else
+        case OP_CH_TOGGLE:
+            return send(CMD_CHANNEL_TOGGLE, 0, arg[0].i);
+        case OP_CH_RELAY:
+            return send(CMD_CHANNEL_SET_RELAY, arg[1].i, arg[0].i);
+        case OP_CH_TARGET:
+            return send(CMD_CHANNEL_TARGET, arg[1].f, arg[0].i);
+        case OP_CH_RESET:
+            return send(CMD_CHANNEL_RESET, 0, arg[0].i);
+#endif
+        case OP_SET_CALIB: {
+            CalibPoint points[CALIB_MAX_POINTS];
+            uint8_t count = parseCalibration(arg[0].text, points);
+            if (!calibValid(points, count)) return "invalid calibration";
+            if (!setCalibration(points, count, ticket)) return "busy";
+            queued = true; // Saved by loop() once the control task has loaded it
+            return nullptr;
+        }
+        case OP_RESET_CALIB:
+            if (!setCalibration(DEFAULT_CALIBRATION, 2, ticket)) return "busy";
+            queued = true;
+            return nullptr;
+    }
+    return "not available here";
+}
+
 void flowControlTask(void * pvParameters) {
-    unsigned long lastCalc = millis();
     esp_task_wdt_add(NULL); 
     Serial.println("[TASK] FlowControlTask started on Core 1");
+    if (!sampler.begin(SAMPLE_RATE_HZ, xTaskGetCurrentTaskHandle())) emitEvent(EVT_FAULT, FAULT_SAMPLER_INIT);
+
+    bool adcDma = false;
+#if FLOW_INPUT_MODE == FLOW_INPUT_ADC_DMA
+    adcDma = flowAdc.begin(FLOW_SENSOR_PIN);
+    if (!adcDma) emitEvent(EVT_FAULT, FAULT_ADC_INIT);
+#endif
+    bool pulseInput = false;
+#if FLOW_INPUT_MODE == FLOW_INPUT_PULSE
+    pulseInput = flowPulses.begin(FLOW_SENSOR_PIN, PULSE_K_FACTOR, PULSE_FILTER_NS);
+    if (!pulseInput) emitEvent(EVT_FAULT, FAULT_PULSE_INIT);
+#endif
+    // Unfiltered volume total; the cutoff learns its latency from it
+    FlowTotalizer rawVolume;
 
     for(;;) {
         esp_task_wdt_reset(); 
-        unsigned long now = millis();
-        int raw = analogRead(FLOW_SENSOR_PIN);
-        
-        float raw_flow = (float)(raw - 744) * 100.0 / (3720 - 744);
-        if (raw_flow < 0) raw_flow = 0;
+        int64_t sampleUs;
+        uint32_t dtUs;
+        if (!sampler.wait(sampleUs, dtUs, pdMS_TO_TICKS(1000))) {
+            emitEvent(EVT_FAULT, FAULT_TICK_TIMEOUT);
+            continue;
+        }
+
+        Command cmd;
+        while (xQueueReceive(commandQueue, &cmd, 0) == pdTRUE) {
+            if (!applyCommand(cmd) && cmd.ticket) emitEvent(EVT_COMMAND_REFUSED, 0, cmd.channel, 0, 0, cmd.ticket);
+        }
+
+        // Pulse meters measure volume directly: the counted volume is what
+        // gets totalized, the filtered rate only drives the cutoff and UI
+        float raw_flow;
+        int64_t pulseUl = 0;
+        if (pulseInput) {
+            uint32_t counts = flowPulses.sample();
+            pulseUl = flowPulses.toMicroLitres(counts);
+            raw_flow = flowPulses.flowLpm(counts, dtUs);
+        } else {
+            float raw = adcDma ? flowAdc.read() : analogRead(FLOW_SENSOR_PIN);
+            raw_flow = calibration.lookup(raw);
+        }
         state.currentFlow = flowFilter.update(raw_flow);
+        if (pulseInput) rawVolume.addMicroLitres(pulseUl);
+        else rawVolume.add(raw_flow, dtUs);
+#if FLOW_CHANNELS == 1
+        scope.add(raw_flow, state.currentFlow, sampler.periodUs(), sampleUs);
+#endif
 
         if (state.relayActive && !state.targetReached) {
-            float timeStep = (now - lastCalc) / 1000.0;
-            state.accumulatedVolume += (state.currentFlow / 60.0) * timeStep;
+            if (pulseInput) state.volume.addMicroLitres(pulseUl);
+            else state.volume.add(state.currentFlow, dtUs);
+
+            // The one-shot timer may already have dropped the relay between ticks
+            int64_t targetUl = FlowTotalizer::fromLitres(state.volumeTarget);
+            if (!cutoff.fired() && state.volume.microLitres() >= targetUl) cutoff.trip();
 
-            if (state.accumulatedVolume >= state.volumeTarget) {
-                state.accumulatedVolume = state.volumeTarget;
+            if (cutoff.fired()) {
+                cutoff.finish(targetUl, state.currentFlow, rawVolume.microLitres());
                 state.targetReached = true;
                 state.relayActive = false;
-                digitalWrite(RELAY_PIN, LOW);
-                pendingCompletionMqtt = true; // Flag for MQTT task
-                Serial.println("[CRITICAL] Target Reached. Pump OFF.");
-                broadcastStatus();
+                publishSnapshot();
+                emitEvent(EVT_TARGET_REACHED, 0, 0, state.volume.microLitres(), state.currentFlow);
+            } else {
+                cutoff.plan(state.volume.microLitres(), targetUl, state.currentFlow, sampler.periodUs());
+            }
+        } else if (cutoff.settling()) {
+            // Keep counting what still flows through the closing valve
+            if (pulseInput) state.volume.addMicroLitres(pulseUl);
+            else state.volume.add(state.currentFlow, dtUs);
+            if (cutoff.settle(state.volume.microLitres(), rawVolume.microLitres())) {
+                publishSnapshot(); // Final figures must be visible before the event
+                emitEvent(EVT_BATCH_SETTLED, 0, 0, state.volume.microLitres());
             }
+        } else {
+            state.volume.hold(state.currentFlow);
         }
-        lastCalc = now;
-        vTaskDelay(pdMS_TO_TICKS(100));
+        publishSnapshot();
     }
 }
 
-void handleRoot() { server.send_P(200, "text/html", INDEX_HTML); }
+#if FLOW_CHANNELS > 1
+void publishChannels() {
+    ChannelSnapshot s;
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+        s.volumeUl[i] = channels.volumeUl(i);
+        s.flow[i] = channels.flow(i);
+        s.volume[i] = channels.volumeUl(i) * 1e-6f;
+        s.target[i] = channels.targetUl(i) * 1e-6f;
+        s.runMs[i] = channels.runMs(i);
+    }
+    s.relayMask = channels.relayMask();
+    s.reachedMask = channels.reachedMask();
+    s.valveActive = state.valveActive;
+    channelSnapshot.write(s);
+}
 
-void broadcastStatus() {
-    StaticJsonDocument<256> volDoc;
-    unsigned long currentSession = state.accumulatedTimeMs;
-    if (state.relayActive) currentSession += (millis() - state.relayStartTime);
+// Multi-line variant of flowControlTask: one pass over the whole bank per tick
+void channelScanTask(void * pvParameters) {
+    esp_task_wdt_add(NULL);
+    Serial.println("[TASK] ChannelScanTask started on Core 1");
+    if (!sampler.begin(SAMPLE_RATE_HZ, xTaskGetCurrentTaskHandle())) emitEvent(EVT_FAULT, FAULT_SAMPLER_INIT);
 
-    volDoc["type"] = "volumeUpdate";
-    volDoc["vol"] = state.accumulatedVolume;
-    volDoc["target"] = state.volumeTarget;
-    volDoc["elapsed"] = currentSession / 1000;
-    volDoc["targetReached"] = state.targetReached;
-    volDoc["uptime"] = millis() / 1000;
-    volDoc["relayActive"] = state.relayActive;
-    volDoc["valveActive"] = state.valveActive;
+    for(;;) {
+        esp_task_wdt_reset();
+        int64_t sampleUs;
+        uint32_t dtUs;
+        if (!sampler.wait(sampleUs, dtUs, pdMS_TO_TICKS(1000))) {
+            emitEvent(EVT_FAULT, FAULT_TICK_TIMEOUT);
+            continue;
+        }
 
-    String volMsg;
-    serializeJson(volDoc, volMsg);
-    webSocket.broadcastTXT(volMsg);
+        Command cmd;
+        while (xQueueReceive(commandQueue, &cmd, 0) == pdTRUE) {
+            if (!applyCommand(cmd) && cmd.ticket) emitEvent(EVT_COMMAND_REFUSED, 0, cmd.channel, 0, 0, cmd.ticket);
+        }
 
-    StaticJsonDocument<128> flowDoc;
-    flowDoc["type"] = "flow";
-    flowDoc["val"] = state.currentFlow;
-    
-    String flowMsg;
-    serializeJson(flowDoc, flowMsg);
-    webSocket.broadcastTXT(flowMsg);
+        float flowIn[FLOW_CHANNELS];
+        for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+            flowIn[i] = calibration.lookup(analogRead(CHANNEL_SENSOR_PINS[i]));
+        }
+
+        uint8_t done = channels.update(flowIn, dtUs);
+        publishChannels(); // Final figures must be visible before the events
+        for (uint8_t i = 0; done; i++, done >>= 1) {
+            if (done & 1) emitEvent(EVT_TARGET_REACHED, 0, i, channels.volumeUl(i), channels.flow(i));
+        }
+    }
+}
+
+// One array per field, pump states as bitmasks
+void addChannelArrays(JsonWriter &json, const ChannelSnapshot &s) {
+    json.beginArray("flow");
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) json.item(s.flow[i], 3);
+    json.endArray();
+    json.beginArray("vol");
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) json.item(s.volume[i], 3);
+    json.endArray();
+    json.beginArray("target");
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) json.item(s.target[i], 3);
+    json.endArray();
+    json.beginArray("elapsed");
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) json.item((int64_t)(s.runMs[i] / 1000));
+    json.endArray();
+    json.integer("relay", s.relayMask);
+    json.integer("done", s.reachedMask);
+    json.boolean("valve", s.valveActive);
+}
+#endif
+
+// A file from the asset store, streamed from flash; false when it is not
+// stored, or is stored gzipped for a browser that cannot take that
+bool serveAsset(const char *uri) {
+    char path[ASSET_NAME_MAX + 2];
+    char etag[24];
+    bool gzipped;
+    if (!assets.find(uri, path, sizeof(path), gzipped, etag, sizeof(etag))) return false;
+    if (gzipped && server.header("Accept-Encoding").indexOf("gzip") < 0) return false;
+    server.sendHeader("Vary", "Accept-Encoding");
+    server.sendHeader("Cache-Control", "no-cache"); // Changes with each upload
+    server.sendHeader("ETag", etag);
+    if (server.header("If-None-Match").indexOf(etag) >= 0) {
+        server.send(304);
+        return true;
+    }
+    server.sendFile(LittleFS, path, AssetStore::mimeType(path));
+    return true;
+}
+
+// An uploaded index.html(.gz) first. Then the page gzipped when the build
+// generated it (embed_html.py) and the browser accepts it; INDEX_HTML as
+// is otherwise. Browsers keep it but revalidate each load; an unchanged
+// page costs a bare 304.
+void handleRoot() {
+    if (serveAsset("/")) return;
+#ifdef INDEX_HTML_GZ_H
+    bool gzip = server.header("Accept-Encoding").indexOf("gzip") >= 0;
+    const char *etag = gzip ? INDEX_HTML_GZ_ETAG : INDEX_HTML_ETAG;
+    server.sendHeader("Vary", "Accept-Encoding");
+    server.sendHeader("Cache-Control", "no-cache"); // Changes with the firmware, not on a schedule
+    server.sendHeader("ETag", etag);
+    if (server.header("If-None-Match").indexOf(etag) >= 0) {
+        server.send(304);
+        return;
+    }
+    if (gzip) {
+        server.sendHeader("Content-Encoding", "gzip");
+        server.send_P(200, "text/html", (PGM_P)INDEX_HTML_GZ, INDEX_HTML_GZ_LEN);
+        return;
+    }
+#endif
+    server.send_P(200, "text/html", INDEX_HTML);
+}
+
+#ifdef FONT_WOFF2_H
+// Dashboard font, subsetted by embed_html.py when platformio.ini sets
+// custom_embed_font. woff2 is compressed already, so no gzip; cached for a
+// week, then revalidated.
+void handleFont() {
+    server.sendHeader("Cache-Control", "max-age=604800");
+    server.sendHeader("ETag", FONT_WOFF2_ETAG);
+    if (server.header("If-None-Match").indexOf(FONT_WOFF2_ETAG) >= 0) {
+        server.send(304);
+        return;
+    }
+    server.send_P(200, "font/woff2", (PGM_P)FONT_WOFF2, FONT_WOFF2_LEN);
+}
+#endif
+
+// Any other file the uploaded UI refers to
+void handleAsset() {
+    if (!serveAsset(server.uri().c_str())) server.send(404, "text/plain", "Not Found");
+}
+
+#ifdef ASSET_UPLOAD_PASSWORD
+// POST /assets: a multipart file upload, stored under its file name, e.g.
+//   curl -u admin:<password> -F file=@data/index.html.gz http://<device>/assets
+// Whoever holds the password can replace the UI; DELETE
+// /assets?name=index.html.gz brings back the built-in page. Chunks of an
+// unauthenticated upload are discarded as they arrive.
+void handleAssetChunk(const char *name, size_t index, const uint8_t *data, size_t len, bool final) {
+    if (!server.authenticate(ASSET_UPLOAD_USER, ASSET_UPLOAD_PASSWORD)) return;
+    assets.upload(name, index, data, len, final);
+}
+
+void handleAssetUpload() {
+    if (!server.authenticate(ASSET_UPLOAD_USER, ASSET_UPLOAD_PASSWORD)) {
+        server.requestAuthentication();
+        return;
+    }
+    const char *name;
+    size_t size;
+    if (!assets.takeUpload(name, size)) {
+        server.send(400, "text/plain", assets.mounted() ? "Upload failed" : "No filesystem");
+        return;
+    }
+    Serial.printf("[SYSTEM] Stored UI asset %s (%u bytes)\n", name, (unsigned)size);
+    char buffer[96];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.string("name", name);
+    json.integer("size", (int64_t)size);
+    json.endObject();
+    server.send(200, "application/json", json.data());
+}
+
+void handleAssetDelete() {
+    if (!server.authenticate(ASSET_UPLOAD_USER, ASSET_UPLOAD_PASSWORD)) {
+        server.requestAuthentication();
+        return;
+    }
+    String name = server.arg("name");
+    if (assets.remove(name.c_str())) server.send(200, "text/plain", "Deleted");
+    else server.send(404, "text/plain", "Not Found");
+}
+#endif
+
+// Bit n: client n asked for binary status frames ("format:bin")
+uint32_t binaryClients = 0;
+
+// Every status publish and control event is numbered; the last few events
+// are kept for clients that reconnect with "resume:<seq>"
+#define EVENT_LOG_SIZE 32
+EventLog<ControlEvent, EVENT_LOG_SIZE> eventLog;
+uint32_t statusSeq = 0; // Number of the latest status publish
+
+StatusFrame makeStatusFrame(const StatusSnapshot &s) {
+    StatusFrame f;
+    f.version = STATUS_FRAME_VERSION;
+    f.type = FRAME_STATUS;
+    f.flags = (s.relayActive ? STATUS_FLAG_RELAY : 0) |
+              (s.valveActive ? STATUS_FLAG_VALVE : 0) |
+              (s.targetReached ? STATUS_FLAG_TARGET_REACHED : 0);
+    f.flow = s.currentFlow;
+    f.volume = s.volume;
+    f.target = s.volumeTarget;
+    f.elapsed = s.sessionMs / 1000;
+    f.uptime = millis() / 1000;
+    f.seq = statusSeq;
+    return f;
+}
+
+// Report by exception: periodic pushes only go out when a field moved past
+// its deadband (half the dashboard's display resolution) or as a keyframe.
+#define STATUS_DEADBAND_FLOW 0.05f    // L/min, shown to 0.1
+#define STATUS_DEADBAND_VOLUME 0.005f // L, shown to 0.01
+#define STATUS_KEYFRAME_MS 5000
+#define STATUS_DEFAULT_INTERVAL_MS 200 // 5 Hz for clients that do not subscribe
+#if FLOW_CHANNELS > 1
+#define STATUS_FIELDS (3 * FLOW_CHANNELS + 3) // flow[], vol[], target[], relay, done, valve
+typedef ChannelSnapshot UiSnapshot;
+#else
+#define STATUS_FIELDS 5 // flow, vol, target, elapsed, flags
+typedef StatusSnapshot UiSnapshot;
+#endif
+ReportByException<STATUS_FIELDS> statusReport;
+
+// WebSocket topics, each client at the rate it subscribed at. Binary
+// clients get the status topic as a frame, which carries the flow as well.
+// The scope topic is opt-in and sends every chunk as it comes.
+#if FLOW_CHANNELS > 1
+enum Topic : uint8_t { TOPIC_STATUS, TOPIC_COUNT };
+const TopicInfo TOPICS[TOPIC_COUNT] = {
+    {"status", STATUS_DEFAULT_INTERVAL_MS, STATUS_FRAME_INTERVAL_MS},
+};
+#else
+enum Topic : uint8_t { TOPIC_STATUS, TOPIC_FLOW, TOPIC_SCOPE, TOPIC_COUNT };
+const TopicInfo TOPICS[TOPIC_COUNT] = {
+    {"status", STATUS_DEFAULT_INTERVAL_MS, STATUS_FRAME_INTERVAL_MS}, // volumeUpdate
+    {"flow", STATUS_DEFAULT_INTERVAL_MS, STATUS_FRAME_INTERVAL_MS},
+    {"scope", 0, 1},
+};
+#endif
+ClientSubscriptions<WEBSOCKETS_SERVER_CLIENT_MAX, TOPIC_COUNT> subscriptions;
+
+// JSON status text is written into these buffers and sent straight from
+// them. Sized for the worst case of sendStatus()'s field lists, every
+// number at JSON_NUMBER_MAX.
+#if FLOW_CHANNELS > 1
+#define STATUS_JSON_SIZE (224 + 4 * FLOW_CHANNELS * (JSON_NUMBER_MAX + 1))
+#else
+#define STATUS_JSON_SIZE 352
+char flowJson[96];
+#endif
+char statusJson[STATUS_JSON_SIZE];
+
+void initStatusReports() {
+    float deadbands[STATUS_FIELDS] = {};
+#if FLOW_CHANNELS > 1
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+        deadbands[i] = STATUS_DEADBAND_FLOW;
+        deadbands[FLOW_CHANNELS + i] = STATUS_DEADBAND_VOLUME;
+    }
+#else
+    deadbands[0] = STATUS_DEADBAND_FLOW;
+    deadbands[1] = STATUS_DEADBAND_VOLUME;
+#endif
+    statusReport.begin(deadbands, STATUS_KEYFRAME_MS);
+    subscriptions.begin(TOPICS);
+}
+
+UiSnapshot readUiSnapshot() {
+#if FLOW_CHANNELS > 1
+    return channelSnapshot.read();
+#else
+    return statusSnapshot.read();
+#endif
+}
+
+void statusFields(const UiSnapshot &s, float *v) {
+#if FLOW_CHANNELS > 1
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+        v[i] = s.flow[i];
+        v[FLOW_CHANNELS + i] = s.volume[i];
+        v[2 * FLOW_CHANNELS + i] = s.target[i];
+    }
+    v[3 * FLOW_CHANNELS] = s.relayMask;
+    v[3 * FLOW_CHANNELS + 1] = s.reachedMask;
+    v[3 * FLOW_CHANNELS + 2] = s.valveActive;
+#else
+    v[0] = s.currentFlow;
+    v[1] = s.volume;
+    v[2] = s.volumeTarget;
+    v[3] = s.sessionMs / 1000;
+    v[4] = makeStatusFrame(s).flags;
+#endif
+}
+
+// Per-client send queues: nothing writes to a socket directly; loop()
+// drains each queue as fast as that client's link takes it
+#define CLIENT_QUEUE_DEPTH 8 // A command can raise a few control events plus a forced status
+#define CLIENT_SLOW_MS 3000 // Oldest queued message this old: the client is dropped
+#if FLOW_CHANNELS > 1
+#define CLIENT_MESSAGE_MAX STATUS_JSON_SIZE
+#else
+#define CLIENT_MESSAGE_MAX (sizeof(ScopeChunk) > STATUS_JSON_SIZE ? sizeof(ScopeChunk) : STATUS_JSON_SIZE)
+#endif
+ClientSendQueues<WEBSOCKETS_SERVER_CLIENT_MAX, CLIENT_QUEUE_DEPTH, CLIENT_MESSAGE_MAX> sendQueues;
+uint32_t overflowedClients = 0; // Lost a control message; disconnected by flushClients()
+
+// Client sets are bitmasks of WebSocket slots
+void queueMessage(uint32_t clients, const void *data, size_t len, bool binary, SendClass cls) {
+    uint32_t now = millis();
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        if ((clients & (1u << num)) && !sendQueues.push(num, data, len, binary, cls, now)) {
+            overflowedClients |= 1u << num;
+        }
+    }
+}
+
+void sendText(uint32_t clients, const JsonWriter &json, SendClass cls) {
+    if (json.ok()) queueMessage(clients, json.data(), json.length(), false, cls);
+}
+
+// Trend history: one point a second for the last half hour. "history"
+// sends it as one binary message, written straight from the ring by
+// flushClients() a fragment at a time as the client's socket takes it.
+// Nothing may come between the fragments, so the client's queued messages
+// wait behind the transfer, and the ring holds still until every transfer
+// is done. With several channels the trend is the plant total.
+#define HISTORY_POINTS 1800 // 30 min
+#define HISTORY_PERIOD_MS 1000
+HistoryRing<HISTORY_POINTS> history;
+uint32_t historyClients = 0; // Transfer in progress
+uint16_t historySent[WEBSOCKETS_SERVER_CLIENT_MAX]; // Bytes written so far
+static_assert(HistoryRing<HISTORY_POINTS>::maxMessageBytes() <= UINT16_MAX, "historySent counts bytes in 16 bits");
+
+// Every status check feeds the ring; it keeps one point per period
+void recordHistory() {
+    UiSnapshot s = readUiSnapshot();
+#if FLOW_CHANNELS > 1
+    float flow = 0, volume = 0;
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+        flow += s.flow[i];
+        volume += s.volume[i];
+    }
+#else
+    float flow = s.currentFlow, volume = s.volume;
+#endif
+    history.sample(flow, volume, millis(), historyClients != 0);
+}
+
+void sendHistory(uint8_t num) {
+    if (historyClients & (1u << num)) return; // Already on its way
+    historySent[num] = 0;
+    historyClients |= 1u << num;
+}
+
+// True once the client's transfer is done and its queue may go next
+bool pumpHistory(uint8_t num) {
+    size_t total = history.messageBytes();
+    while (historySent[num] < total) {
+        if (!webSocket.writable(num)) return false;
+        bool first = historySent[num] == 0;
+        if (first) history.stamp(millis());
+        size_t len = total - historySent[num];
+        if (len > WS_FRAGMENT_MAX) len = WS_FRAGMENT_MAX;
+        if (!webSocket.sendFragment(num, history.message() + historySent[num], len, first,
+                                    historySent[num] + len == total)) {
+            historyClients &= ~(1u << num);
+            return false;
+        }
+        historySent[num] += len;
+    }
+    historyClients &= ~(1u << num);
+    Serial.printf("[WS] Client #%u: %u history points, %u bytes\n", num, history.count(), (unsigned)total);
+    return true;
+}
+
+// Writes each client's queue only while its socket has room, so a
+// congested link never blocks loop(). Clients that stopped reading are
+// disconnected.
+void flushClients() {
+    uint32_t now = millis();
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        const auto *msg = sendQueues.front(num);
+        bool overflowed = overflowedClients & (1u << num);
+        if (overflowed || (msg && now - msg->queuedMs > CLIENT_SLOW_MS)) {
+            overflowedClients &= ~(1u << num);
+            Serial.printf("[WS] Client %u too slow (%s), disconnecting\n", num, overflowed ? "control queue full" : "stalled");
+            webSocket.disconnect(num); // Clears its queue via WStype_DISCONNECTED
+            continue;
+        }
+        if ((historyClients & (1u << num)) && !pumpHistory(num)) continue;
+        for (; msg && webSocket.writable(num); msg = sendQueues.front(num)) {
+            uint32_t start = micros();
+            if (msg->binary) webSocket.sendBIN(num, msg->data, msg->len);
+            else webSocket.sendTXT(num, msg->data, msg->len);
+            sendQueues.sent(num, micros() - start, now);
+        }
+    }
+}
+
+// Per-client queue depth and write latency, one array per field indexed by
+// WebSocket slot. On the async transport this runs on the TCP task and
+// reads loop()'s counters as they stand; a figure may be one update stale.
+void handleMetrics() {
+    char buffer[1024];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.beginArray("connected");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) json.item((int64_t)webSocket.clientIsConnected(num));
+    json.endArray();
+    json.beginArray("depth");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) json.item((int64_t)sendQueues.depth(num));
+    json.endArray();
+    json.beginArray("maxDepth");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) json.item((int64_t)sendQueues.stats(num).maxDepth);
+    json.endArray();
+    json.beginArray("sent");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) json.item((int64_t)sendQueues.stats(num).sent);
+    json.endArray();
+    json.beginArray("dropped");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) json.item((int64_t)sendQueues.stats(num).dropped);
+    json.endArray();
+    json.beginArray("sendUsAvg");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        const auto &s = sendQueues.stats(num);
+        json.item((int64_t)(s.sent ? s.sendUsTotal / s.sent : 0));
+    }
+    json.endArray();
+    json.beginArray("sendUsMax");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) json.item((int64_t)sendQueues.stats(num).sendUsMax);
+    json.endArray();
+    json.beginArray("waitMsMax");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) json.item((int64_t)sendQueues.stats(num).waitMsMax);
+    json.endArray();
+    json.endObject();
+    if (json.ok()) server.send(200, "application/json", json.data());
+    else server.send(500);
+}
+
+// Binary clients get one frame (flow and volume together); JSON clients
+// get the status and flow messages they subscribed to. Client sets are
+// bitmasks of WebSocket slots.
+void sendStatus(const UiSnapshot &s, uint32_t frameClients, uint32_t textClients, uint32_t flowClients, SendClass cls) {
+#if FLOW_CHANNELS > 1
+    if (!textClients) return;
+    // All channels in one message
+    JsonWriter json(statusJson, sizeof(statusJson));
+    json.beginObject();
+    json.string("type", "channels");
+    json.integer("seq", statusSeq);
+    addChannelArrays(json, s);
+    json.integer("uptime", millis() / 1000);
+    json.number("jitterUs", sampler.stats().jitterRmsUs, 1);
+    json.endObject();
+    sendText(textClients, json, cls);
+#else
+    if (frameClients) {
+        StatusFrame frame = makeStatusFrame(s);
+        queueMessage(frameClients, &frame, sizeof(frame), true, cls);
+    }
+    if (textClients) {
+        JsonWriter vol(statusJson, sizeof(statusJson));
+        vol.beginObject();
+        vol.string("type", "volumeUpdate");
+        vol.integer("seq", statusSeq);
+        vol.number("vol", s.volume, 3);
+        vol.number("target", s.volumeTarget, 3);
+        vol.integer("elapsed", s.sessionMs / 1000);
+        vol.boolean("targetReached", s.targetReached);
+        vol.integer("uptime", millis() / 1000);
+        vol.boolean("relayActive", s.relayActive);
+        vol.boolean("valveActive", s.valveActive);
+        vol.number("jitterUs", sampler.stats().jitterRmsUs, 1);
+        vol.number("overshoot", s.cutoff.lastOvershootL, 4);
+        vol.endObject();
+        sendText(textClients, vol, cls);
+    }
+    if (flowClients) {
+        JsonWriter flow(flowJson, sizeof(flowJson));
+        flow.beginObject();
+        flow.string("type", "flow");
+        flow.integer("seq", statusSeq);
+        flow.number("val", s.currentFlow, 3);
+        flow.endObject();
+        sendText(flowClients, flow, cls);
+    }
+#endif
+}
+
+#if FLOW_CHANNELS == 1
+// Diagnostic waveform: every chunk to every scope subscriber, in order.
+// A client on a slow link loses its oldest queued chunks; if loop() itself
+// falls behind, the capture ring fills and the control task drops whole
+// chunks instead of waiting.
+void drainScope() {
+    uint32_t clients = subscriptions.subscribers(TOPIC_SCOPE);
+    scope.setEnabled(clients != 0);
+    ScopeChunk chunk;
+    while (scope.pop(chunk)) queueMessage(clients, &chunk, scopeChunkBytes(chunk), true, SEND_STATUS);
+}
+#endif
+
+// Periodic push. The gate decides whether there is anything new, then each
+// subscriber gets it in its own next slot; nothing is encoded unless some
+// client is due.
+void reportStatus(bool force = false) {
+    uint32_t subscribed = subscriptions.subscribers(TOPIC_STATUS);
+#if FLOW_CHANNELS == 1
+    subscribed |= subscriptions.subscribers(TOPIC_FLOW);
+#endif
+    if (!subscribed) return;
+    UiSnapshot s = readUiSnapshot();
+    float v[STATUS_FIELDS];
+    statusFields(s, v);
+    uint32_t now = millis();
+
+    if (force || statusReport.due(v, now)) {
+        statusReport.sent(v, now);
+        statusSeq = eventLog.next();
+        subscriptions.publish(TOPIC_STATUS);
+#if FLOW_CHANNELS == 1
+        subscriptions.publish(TOPIC_FLOW);
+#endif
+    }
+    uint32_t status = subscriptions.due(TOPIC_STATUS, now, force);
+#if FLOW_CHANNELS > 1
+    uint32_t flow = 0;
+#else
+    uint32_t flow = subscriptions.due(TOPIC_FLOW, now, force) & ~binaryClients;
+#endif
+    if (status || flow) sendStatus(s, status & binaryClients, status & ~binaryClients, flow, force ? SEND_CONTROL : SEND_STATUS);
+}
+
+// Immediate push to every subscriber regardless of rate (state changes)
+void broadcastStatus() { reportStatus(true); }
+
+// Full current state to one client, outside its subscription schedule
+void sendSnapshot(uint8_t num) {
+    uint32_t client = 1u << num;
+#if FLOW_CHANNELS > 1
+    uint32_t flow = 0;
+#else
+    uint32_t flow = subscriptions.subscribers(TOPIC_FLOW) & client & ~binaryClients;
+#endif
+    sendStatus(readUiSnapshot(), client & binaryClients, client & ~binaryClients, flow, SEND_CONTROL);
+}
+
+#define EVENT_JSON_SIZE 200
+char eventJson[EVENT_JSON_SIZE];
+
+void sendEvent(uint32_t clients, uint32_t seq, const ControlEvent &ev) {
+    static const char *const names[] = {"state", "relay", "reset", "target", "settled", "calibration", "fault"};
+    JsonWriter json(eventJson, sizeof(eventJson));
+    json.beginObject();
+    json.string("type", "event");
+    json.integer("seq", seq);
+    json.string("event", ev.type < sizeof(names) / sizeof(names[0]) ? names[ev.type] : "unknown");
+    json.integer("ch", ev.channel);
+    json.integer("code", ev.code);
+    json.number("vol", ev.volumeUl * 1e-6f, 3);
+    json.number("flow", ev.flow, 3);
+    json.integer("t", ev.timeMs);
+    json.endObject();
+    sendText(clients, json, SEND_CONTROL);
+}
+
+// resume:<seq>: the logged events after the client's last number, in
+// order, then the current state. Replay is paced by pumpResumes() to what
+// the client's queue can take; live events wait in the log meanwhile.
+// When the log cannot cover the gap the client is told so and just
+// resyncs from the snapshot.
+uint32_t resumingClients = 0;
+uint32_t resumeSeq[WEBSOCKETS_SERVER_CLIENT_MAX]; // Last event replayed
+uint8_t resumeReplayed[WEBSOCKETS_SERVER_CLIENT_MAX];
+
+void finishResume(uint8_t num, bool complete) {
+    resumingClients &= ~(1u << num);
+    JsonWriter json(eventJson, sizeof(eventJson));
+    json.beginObject();
+    json.string("type", "resume");
+    json.integer("replayed", resumeReplayed[num]);
+    json.boolean("complete", complete);
+    json.endObject();
+    sendText(1u << num, json, SEND_CONTROL);
+    sendSnapshot(num);
+    Serial.printf("[WS] Client %u resumed: %u events replayed%s\n", num, resumeReplayed[num],
+                  complete ? "" : ", gap (resync)");
+}
+
+void resumeClient(uint8_t num, uint32_t after) {
+    resumeSeq[num] = after;
+    resumeReplayed[num] = 0;
+    if (eventLog.covers(after)) resumingClients |= 1u << num;
+    else finishResume(num, false);
+}
+
+// Half the queue at most, leaving room for live control messages
+void pumpResumes() {
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        if (!(resumingClients & (1u << num))) continue;
+        uint32_t seq;
+        ControlEvent ev;
+        while (sendQueues.depth(num) < CLIENT_QUEUE_DEPTH / 2) {
+            if (!eventLog.covers(resumeSeq[num])) {
+                finishResume(num, false); // Overwritten while we were replaying
+                break;
+            }
+            if (!eventLog.eventAfter(resumeSeq[num], seq, ev)) {
+                finishResume(num, true);
+                break;
+            }
+            sendEvent(1u << num, seq, ev);
+            resumeSeq[num] = seq;
+            resumeReplayed[num]++;
+        }
+    }
+}
+
+// Requests ("#<id> <command>") waiting for the control task's verdict, by
+// ticket. A slot is reused PENDING_REPLIES requests later; the control task
+// answers within a tick, long before that.
+#define PENDING_REPLIES 16
+struct PendingReply {
+    uint32_t id;
+    uint32_t receivedUs;
+    uint16_t ticket; // 0: free
+    uint8_t client;
+};
+PendingReply pendingReplies[PENDING_REPLIES];
+uint16_t lastTicket = 0;
+
+uint16_t nextTicket() {
+    if (++lastTicket == 0) lastTicket = 1; // 0 means no ticket
+    return lastTicket;
+}
+
+// ack, or nack with the reason; us is the time from receiving the frame to
+// the verdict
+void sendReply(uint8_t num, uint32_t id, const char *refused, uint32_t receivedUs) {
+    JsonWriter json(eventJson, sizeof(eventJson));
+    json.beginObject();
+    json.string("type", refused ? "nack" : "ack");
+    json.integer("id", id);
+    if (refused) json.string("reason", refused);
+    json.integer("us", micros() - receivedUs);
+    json.endObject();
+    sendText(1u << num, json, SEND_CONTROL);
+}
+
+// The control task's verdict on a ticketed command
+void completeReply(uint16_t ticket, const char *refused) {
+    PendingReply &p = pendingReplies[ticket % PENDING_REPLIES];
+    if (p.ticket != ticket) return; // Client gone, or slot reused
+    p.ticket = 0;
+    sendReply(p.client, p.id, refused, p.receivedUs);
+}
+
+void dropReplies(uint8_t num) {
+    for (uint8_t i = 0; i < PENDING_REPLIES; i++) {
+        if (pendingReplies[i].client == num) pendingReplies[i].ticket = 0;
+    }
+}
+
+// One command from a WebSocket frame. A command with a request id gets an
+// ack or nack: at once, or once the control task has applied it.
+void runClientCommand(uint8_t num, const CommandLine &line, uint32_t receivedUs) {
+    if (line.badId) {
+        Serial.printf("[WS] Client #%u: %.*s REJECTED: bad request id\n", num, (int)line.text.len, line.text.p);
+        return;
+    }
+    ParsedCommand cmd;
+    ParseStatus parsed = parseCommand(COMMANDS, line.text, cmd);
+    const char *refused = nullptr;
+    bool queued = false;
+    if (parsed != PARSE_OK) {
+        refused = parseStatusName(parsed);
+    } else {
+        const CommandArg *arg = cmd.args;
+        switch (cmd.spec->id) {
+            case OP_FORMAT:
+#if FLOW_CHANNELS == 1
+                if (arg[0].text.equals("bin")) binaryClients |= 1u << num;
+                else refused = "unknown format";
+#else
+                refused = "not available here";
+#endif
+                break;
+            case OP_RESUME:
+                resumeClient(num, (uint32_t)arg[0].i);
+                break;
+            case OP_SUBSCRIBE: {
+                int8_t topic = subscriptions.subscribe(num, arg[0].text);
+                if (topic >= 0) {
+                    Serial.printf("[WS] Client #%u: %s every %u ms\n", num, TOPICS[topic].name,
+                                  subscriptions.intervalMs(num, topic));
+                } else {
+                    refused = "bad subscription";
+                }
+                break;
+            }
+            case OP_UNSUBSCRIBE:
+                if (!subscriptions.unsubscribe(num, arg[0].text)) refused = "unknown topic";
+                break;
+            case OP_HISTORY:
+                sendHistory(num);
+                break;
+            default: {
+                // State changes are queued to the control task; the UI syncs
+                // from the status broadcast that follows once they are applied
+                uint16_t ticket = line.hasId ? nextTicket() : 0;
+                refused = runCommand(cmd, ticket, queued);
+                if (queued && ticket) {
+                    PendingReply &p = pendingReplies[ticket % PENDING_REPLIES];
+                    p.id = line.id;
+                    p.receivedUs = receivedUs;
+                    p.ticket = ticket;
+                    p.client = num;
+                }
+                if (refused) broadcastStatus(); // Force sync frontend to revert value
+            }
+        }
+    }
+    if (refused) Serial.printf("[WS] Client #%u: %.*s REJECTED: %s\n", num, (int)line.text.len, line.text.p, refused);
+    if (line.hasId && !queued) sendReply(num, line.id, refused, receivedUs);
 }
 
 void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
     if (type == WStype_CONNECTED) {
+        binaryClients &= ~(1u << num); // Slots are reused; every client starts on JSON
+        subscriptions.connect(num);
+        sendQueues.clear(num);
+        resumingClients &= ~(1u << num);
+        historyClients &= ~(1u << num);
+        dropReplies(num);
+        sendSnapshot(num); // No blank gauges until the next publish
         Serial.printf("[WS] Client #%u connected\n", num);
     } else if (type == WStype_DISCONNECTED) {
+        binaryClients &= ~(1u << num);
+        subscriptions.disconnect(num);
+        sendQueues.clear(num);
+        resumingClients &= ~(1u << num);
+        historyClients &= ~(1u << num);
+        overflowedClients &= ~(1u << num);
+        dropReplies(num);
         Serial.printf("[WS] Client #%u disconnected\n", num);
     } else if (type == WStype_TEXT) {
-        String text = String((char*)payload);
-        if (text.startsWith("toggle:")) {
-            int pin = text.substring(7).toInt();
-            if (pin == RELAY_PIN) {
-                state.relayActive = !state.relayActive;
-                digitalWrite(RELAY_PIN, state.relayActive ? HIGH : LOW);
-                
-                if (state.relayActive) {
-                    bool isNewBatch = (state.accumulatedVolume <= 0.01 || state.targetReached);
-                    if (state.targetReached) { 
-                        state.accumulatedVolume = 0; 
-                        state.accumulatedTimeMs = 0; 
-                        state.targetReached = false; 
-                    }
-                    if (isNewBatch) {
-                        state.batchStartTime = time(nullptr);
-                        state.batchStartMillis = millis();
-                        state.pauseCount = 0;
-                    }
-                    state.relayStartTime = millis();
-                } else {
-                    state.accumulatedTimeMs += (millis() - state.relayStartTime);
-                    state.pauseCount++;
-                    saveVolumeToNVS();
-                }
-            } else if (pin == VALVE_PIN) {
-                state.valveActive = !state.valveActive;
-                digitalWrite(VALVE_PIN, state.valveActive ? HIGH : LOW);
-            }
-            broadcastStatus();
-        } else if (text.startsWith("setTarget:")) {
-            if (state.relayActive) return;
-            float newTarget = text.substring(10).toFloat();
-            if (newTarget > state.accumulatedVolume) {
-                state.volumeTarget = newTarget;
-                state.targetReached = false;
-                broadcastStatus();
-            }
-        } else if (text == "resetBatch") {
-            if (state.relayActive) return;
-            state.accumulatedVolume = 0;
-            state.accumulatedTimeMs = 0;
-            state.targetReached = false;
-            saveVolumeToNVS();
-            broadcastStatus();
-        }
+        // One or more commands, one per line
+        uint32_t receivedUs = micros();
+        TextSpan frame((const char *)payload, length);
+        CommandLine line;
+        while (nextCommandLine(frame, line)) runClientCommand(num, line, receivedUs);
+    }
+}
+
+void loadCalibration() {
+    CalibPoint points[CALIB_MAX_POINTS];
+    size_t len = preferences.getBytesLength("calib");
+    if (len > 0 && len <= sizeof(points) && len % sizeof(CalibPoint) == 0 &&
+        preferences.getBytes("calib", points, len) == len &&
+        calibration.load(points, len / sizeof(CalibPoint))) {
+        Serial.printf("[BOOT] Calibration: %u points from NVS\n", calibration.count());
+        return;
     }
+    calibration.load(DEFAULT_CALIBRATION, 2);
+    Serial.println("[BOOT] Calibration: default 4-20 mA curve");
 }
 
 void saveVolumeToNVS() {
-    preferences.putFloat("lastVol", state.accumulatedVolume);
+    StatusSnapshot s = statusSnapshot.read();
+    preferences.putLong64("lastVolUl", s.volumeUl);
+    preferences.putUInt("cutLatUs", s.cutoff.latencyUs);
+#if FLOW_CHANNELS > 1
+    ChannelSnapshot c = channelSnapshot.read();
+    char key[12];
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+        snprintf(key, sizeof(key), "ch%uVolUl", i);
+        preferences.putLong64(key, c.volumeUl[i]);
+    }
+#endif
     Serial.println("[STORAGE] Volume backed up to NVS");
 }
 
+// The default curve is not stored, so a reset also survives firmware
+// updates that change it
+void saveCalibrationToNVS() {
+    CalibrationSnapshot c = calibrationSnapshot.read();
+    bool isDefault = c.count == 2;
+    for (uint8_t i = 0; isDefault && i < 2; i++) {
+        isDefault = c.points[i].raw == DEFAULT_CALIBRATION[i].raw && c.points[i].flow == DEFAULT_CALIBRATION[i].flow;
+    }
+    if (isDefault) {
+        preferences.remove("calib");
+        Serial.println("[SYSTEM] Calibration reset to default");
+    } else {
+        preferences.putBytes("calib", c.points, c.count * sizeof(CalibPoint));
+        Serial.printf("[SYSTEM] Calibration updated: %u points\n", c.count);
+    }
+}
+
+// Runs in loop(); folds a burst of events into one broadcast and one save
+void handleControlEvent(const ControlEvent &ev, bool &refresh, bool &save) {
+    if (ev.ticket) completeReply(ev.ticket, ev.type == EVT_COMMAND_REFUSED ? "refused by controller" : nullptr);
+    if (ev.type != EVT_COMMAND_REFUSED) {
+        sendEvent(subscriptions.subscribers(TOPIC_STATUS) & ~resumingClients, eventLog.append(ev), ev);
+    }
+    switch (ev.type) {
+        case EVT_COMMAND_REFUSED: // Resyncs the sender's UI
+        case EVT_STATE_CHANGED:
+            break;
+        case EVT_RELAY_CHANGED:
+            if (!ev.code) save = true;
+            break;
+        case EVT_BATCH_RESET:
+            save = true;
+            break;
+        case EVT_TARGET_REACHED:
+#if FLOW_CHANNELS > 1
+            Serial.printf("[CRITICAL] Channel %u Target Reached at %.3f L. Pump OFF.\n", ev.channel, ev.volumeUl * 1e-6f);
+            save = true; // Channels have no settle window
+#else
+            Serial.println("[CRITICAL] Target Reached. Pump OFF.");
+#endif
+            break;
+        case EVT_BATCH_SETTLED: {
+            BatchCutoff::Stats c = statusSnapshot.read().cutoff;
+            Serial.printf("[BATCH] Overshoot %.3f L (mean %.3f, max %.3f over %u), latency %uus\n",
+                          c.lastOvershootL, c.meanOvershootL, c.maxOvershootL, c.batches, c.latencyUs);
+            save = true;
+            break;
+        }
+        case EVT_CALIB_LOADED:
+            saveCalibrationToNVS();
+            break;
+        case EVT_FAULT:
+            switch (ev.code) {
+                case FAULT_SAMPLER_INIT: Serial.println("[CRITICAL] Sample timer init failed."); break;
+                case FAULT_ADC_INIT: Serial.println("[WARN] ADC DMA init failed. Falling back to analogRead."); break;
+                case FAULT_PULSE_INIT: Serial.println("[CRITICAL] Pulse counter init failed."); break;
+                case FAULT_TICK_TIMEOUT: Serial.println("[CRITICAL] No sample tick for 1 s."); break;
+            }
+            return;
+    }
+    refresh = true;
+}
+
 void syncTime() {
     configTime(0, 0, "pool.ntp.org", "time.nist.gov");
     Serial.print("[TIME] Syncing time...");
@@ -214,7 +1418,38 @@ void syncTime() {
     Serial.println(" Time synced!");
 }
 
+void runMqttCommand(TextSpan text) {
+    ParsedCommand cmd;
+    bool queued;
+    ParseStatus parsed = parseCommand(COMMANDS, text, cmd);
+    const char *refused = parsed == PARSE_OK ? runCommand(cmd, 0, queued) : parseStatusName(parsed);
+    if (refused) Serial.printf("[MQTT] %.*s REJECTED: %s\n", (int)text.len, text.p, refused);
+    else Serial.printf("[MQTT] %.*s\n", (int)text.len, text.p);
+}
+
+// The older JSON fields, rewritten as the equivalent text commands
+void runMqttCommandf(const char *format, ...) {
+    char text[48];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (len > 0 && (size_t)len < sizeof(text)) runMqttCommand(TextSpan(text, len));
+}
+
+// Same text commands as the WebSocket ("setTarget:25"), one per line,
+// parsed in place. Request ids are accepted but there is no reply topic:
+// outcomes are only logged. A JSON object is still accepted:
+// {"target": litres, "start": bool}, or {"channel": n, "target": litres,
+// "start": bool, "reset": true} in multi-line mode.
 void messageHandler(char* topic, byte* payload, unsigned int length) {
+    if (!length || payload[0] != '{') {
+        TextSpan frame((const char *)payload, length);
+        CommandLine line;
+        while (nextCommandLine(frame, line)) runMqttCommand(line.text);
+        return;
+    }
+
     StaticJsonDocument<256> doc;
     DeserializationError error = deserializeJson(doc, payload, length);
 
@@ -224,46 +1459,17 @@ void messageHandler(char* topic, byte* payload, unsigned int length) {
         return;
     }
 
-    // Update Target (if present and valid)
-    if (doc.containsKey("target")) {
-        float newTarget = doc["target"].as<float>();
-        if (newTarget > state.accumulatedVolume) {
-            state.volumeTarget = newTarget;
-            state.targetReached = false;
-            Serial.printf("[MQTT] New Target: %.2f L\n", state.volumeTarget);
-        }
-    }
-
-    // Control Relay (Start/Pause)
-    if (doc.containsKey("start")) {
-        bool shouldStart = doc["start"].as<bool>();
-        if (shouldStart != state.relayActive) {
-            state.relayActive = shouldStart;
-            digitalWrite(RELAY_PIN, state.relayActive ? HIGH : LOW);
-            
-            if (state.relayActive) {
-                bool isNewBatch = (state.accumulatedVolume <= 0.01 || state.targetReached);
-                if (state.targetReached) {
-                    state.accumulatedVolume = 0;
-                    state.accumulatedTimeMs = 0;
-                    state.targetReached = false;
-                }
-                if (isNewBatch) {
-                    state.batchStartTime = time(nullptr);
-                    state.batchStartMillis = millis();
-                    state.pauseCount = 0;
-                }
-                state.relayStartTime = millis();
-                Serial.println("[MQTT] Relay: ON");
-            } else {
-                state.accumulatedTimeMs += (millis() - state.relayStartTime);
-                state.pauseCount++;
-                saveVolumeToNVS();
-                Serial.println("[MQTT] Relay: OFF (Paused)");
-            }
-        }
+#if FLOW_CHANNELS > 1
+    if (doc.containsKey("channel")) {
+        int ch = doc["channel"].as<int>();
+        if (doc.containsKey("target")) runMqttCommandf("chTarget:%d:%.3f", ch, doc["target"].as<float>());
+        if (doc.containsKey("start")) runMqttCommandf("chRelay:%d:%d", ch, doc["start"].as<bool>());
+        if (doc.containsKey("reset") && doc["reset"].as<bool>()) runMqttCommandf("chReset:%d", ch);
     }
-    broadcastStatus();
+#else
+    if (doc.containsKey("target")) runMqttCommandf("setTarget:%.3f", doc["target"].as<float>());
+    if (doc.containsKey("start")) runMqttCommandf("setRelay:%d", doc["start"].as<bool>());
+#endif
 }
 
 void connectToMQTT() {
@@ -278,6 +1484,54 @@ void connectToMQTT() {
     }
 }
 
+void publishCompletion(const ControlEvent &ev) {
+    time_t now = time(nullptr);
+    String endTimeStr = ctime(&now);
+    endTimeStr.trim();
+
+#if FLOW_CHANNELS > 1
+    StaticJsonDocument<256> doc;
+    ChannelSnapshot s = channelSnapshot.read();
+    doc["event"] = "BATCH_COMPLETED";
+    doc["channel"] = ev.channel;
+    doc["endTime"] = endTimeStr;
+    doc["durationSeconds"] = s.runMs[ev.channel] / 1000;
+    doc["finalVolume"] = ev.volumeUl * 1e-6f;
+    doc["target"] = s.target[ev.channel];
+
+    char buffer[256];
+#else
+    StaticJsonDocument<512> doc;
+    StatusSnapshot s = statusSnapshot.read();
+
+    // Format Start Time
+    String startTimeStr = "N/A";
+    if (s.batchStartTime > 0) {
+        startTimeStr = ctime(&s.batchStartTime);
+        startTimeStr.trim();
+    }
+
+    doc["event"] = "BATCH_COMPLETED";
+    doc["startTime"] = startTimeStr;
+    doc["endTime"] = endTimeStr;
+    doc["durationSeconds"] = (ev.timeMs - s.batchStartMillis) / 1000;
+    doc["pauseCount"] = s.pauseCount;
+    doc["finalVolume"] = ev.volumeUl * 1e-6f;
+    doc["target"] = s.volumeTarget;
+    doc["overshoot"] = s.cutoff.lastOvershootL;
+    doc["meanOvershoot"] = s.cutoff.meanOvershootL;
+    doc["maxOvershoot"] = s.cutoff.maxOvershootL;
+    doc["cutoffLatencyUs"] = s.cutoff.latencyUs;
+
+    char buffer[512];
+#endif
+    serializeJson(doc, buffer);
+
+    if (client.publish(mqttCompletedTopic.c_str(), buffer)) {
+        Serial.printf("[MQTT] COMPLETE Notification sent to [%s]\n", mqttCompletedTopic.c_str());
+    }
+}
+
 void mqttTask(void * pvParameters) {
     esp_task_wdt_add(NULL); 
     Serial.println("[TASK] MQTTTask heartbeat on Core 0");
@@ -300,17 +1554,22 @@ void mqttTask(void * pvParameters) {
                 // Periodic Publishing (Every 5 seconds)
                 if (millis() - lastPub > 5000) {
                     lastPub = millis();
-                    
-                    StaticJsonDocument<200> doc;
-                    doc["flow"] = state.currentFlow;
-                    doc["volume"] = state.accumulatedVolume;
-                    doc["relay"] = state.relayActive;
-                    doc["target"] = state.volumeTarget;
-
-                    char buffer[200];
-                    serializeJson(doc, buffer);
-                    
-                    if (client.publish(mqttPubTopic.c_str(), buffer)) {
+                    char buffer[STATUS_JSON_SIZE]; // This task's own; statusJson belongs to loop()
+                    JsonWriter json(buffer, sizeof(buffer));
+                    json.beginObject();
+#if FLOW_CHANNELS > 1
+                    addChannelArrays(json, channelSnapshot.read());
+#else
+                    StatusSnapshot s = statusSnapshot.read();
+                    json.number("flow", s.currentFlow, 3);
+                    json.number("volume", s.volume, 3);
+                    json.boolean("relay", s.relayActive);
+                    json.number("target", s.volumeTarget, 3);
+#endif
+                    json.number("jitterUs", sampler.stats().jitterRmsUs, 1);
+                    json.endObject();
+
+                    if (json.ok() && client.publish(mqttPubTopic.c_str(), (const uint8_t *)json.data(), json.length())) {
                         Serial.printf("[MQTT] Published to [%s]: %s\n", mqttPubTopic.c_str(), buffer);
                     } else {
                         Serial.printf("[MQTT] Publish FAILED to [%s]\n", mqttPubTopic.c_str());
@@ -318,38 +1577,8 @@ void mqttTask(void * pvParameters) {
                 }
 
                 // Batch Completion Publishing
-                if (pendingCompletionMqtt) {
-                    pendingCompletionMqtt = false;
-                    
-                    StaticJsonDocument<512> doc;
-                    time_t now = time(nullptr);
-                    
-                    // Format Start Time
-                    String startTimeStr = "N/A";
-                    if (state.batchStartTime > 0) {
-                        startTimeStr = ctime(&state.batchStartTime);
-                        startTimeStr.trim();
-                    }
-                    
-                    // Format End Time
-                    String endTimeStr = ctime(&now);
-                    endTimeStr.trim();
-
-                    doc["event"] = "BATCH_COMPLETED";
-                    doc["startTime"] = startTimeStr;
-                    doc["endTime"] = endTimeStr;
-                    doc["durationSeconds"] = (millis() - state.batchStartMillis) / 1000;
-                    doc["pauseCount"] = state.pauseCount;
-                    doc["finalVolume"] = state.accumulatedVolume;
-                    doc["target"] = state.volumeTarget;
-
-                    char buffer[512];
-                    serializeJson(doc, buffer);
-                    
-                    if (client.publish(mqttCompletedTopic.c_str(), buffer)) {
-                        Serial.printf("[MQTT] COMPLETE Notification sent to [%s]\n", mqttCompletedTopic.c_str());
-                    }
-                }
+                ControlEvent ev;
+                while (mqttEvents.pop(ev)) publishCompletion(ev);
             }
         }
         vTaskDelay(pdMS_TO_TICKS(10)); 
@@ -368,7 +1597,25 @@ void setup() {
     esp_task_wdt_add(NULL); 
 
     preferences.begin("flow", false);
-    state.accumulatedVolume = preferences.getFloat("lastVol", 0);
+    // Older firmware stored the volume as a float in "lastVol"
+    int64_t legacyUl = FlowTotalizer::fromLitres(preferences.getFloat("lastVol", 0));
+    state.volume.set(preferences.getLong64("lastVolUl", legacyUl));
+    cutoff.begin(RELAY_PIN, preferences.getUInt("cutLatUs", 0));
+    loadCalibration();
+    publishSnapshot();
+    eventLog.begin(esp_random());
+    history.begin(HISTORY_PERIOD_MS, millis());
+    if (!assets.begin()) Serial.println("[WARN] LittleFS unavailable; serving the built-in UI only");
+#if FLOW_CHANNELS > 1
+    channels.begin(CHANNEL_RELAY_PINS);
+    char key[12];
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+        snprintf(key, sizeof(key), "ch%uVolUl", i);
+        channels.setVolume(i, preferences.getLong64(key, 0));
+    }
+    publishChannels();
+    Serial.printf("[BOOT] Multi-line mode: %u channels\n", FLOW_CHANNELS);
+#endif
 
     pinMode(RELAY_PIN, OUTPUT);
     pinMode(VALVE_PIN, OUTPUT);
@@ -432,7 +1679,18 @@ void setup() {
         }
     });
 
+    static const char *headerKeys[] = {"Accept-Encoding", "If-None-Match"};
+    server.collectHeaders(headerKeys, 2);
     server.on("/", handleRoot);
+#ifdef FONT_WOFF2_H
+    server.on("/outfit.woff2", handleFont);
+#endif
+    server.on("/metrics", handleMetrics);
+#ifdef ASSET_UPLOAD_PASSWORD
+    server.onUpload("/assets", handleAssetUpload, handleAssetChunk);
+    server.on("/assets", HTTP_DELETE, handleAssetDelete);
+#endif
+    server.onNotFound(handleAsset);
     server.begin();
     webSocket.begin();
     webSocket.onEvent(webSocketEvent);
@@ -444,7 +1702,13 @@ void setup() {
     client.setKeepAlive(60);
 
     // Task Spawning
+    initStatusReports();
+    commandQueue = xQueueCreate(8, sizeof(Command));
+#if FLOW_CHANNELS > 1
+    xTaskCreatePinnedToCore(channelScanTask, "FlowTask", 4096, NULL, 5, NULL, 1);
+#else
     xTaskCreatePinnedToCore(flowControlTask, "FlowTask", 4096, NULL, 5, NULL, 1);
+#endif
     
     if (!isAPMode) {
         xTaskCreatePinnedToCore(mqttTask, "MQTTTask", 16384, NULL, 3, NULL, 0);
@@ -461,15 +1725,60 @@ void loop() {
     server.handleClient();
     webSocket.loop();
 
+    // Events raised by the control task
+    bool refresh = false, save = false;
+    ControlEvent ev;
+    while (controlEvents.pop(ev)) handleControlEvent(ev, refresh, save);
+    if (refresh) broadcastStatus();
+    if (save) saveVolumeToNVS();
+
+    // Change-driven, checked at the fastest rate a client can subscribe at;
+    // unchanged status is not resent
+    static unsigned long lastFrame = 0;
+    if (millis() - lastFrame >= STATUS_FRAME_INTERVAL_MS) {
+        lastFrame = millis();
+        reportStatus();
+        recordHistory();
+    }
+#if FLOW_CHANNELS == 1
+    drainScope();
+#endif
+    pumpResumes();
+    flushClients();
+
     static unsigned long lastUpdate = 0;
     if (millis() - lastUpdate > 200) {
         lastUpdate = millis();
-        broadcastStatus();
-        
+
         static unsigned long lastSave = 0;
         if (millis() - lastSave > 30000) {
             lastSave = millis();
             saveVolumeToNVS();
+
+            FlowSampler::Stats s = sampler.stats();
+            Serial.printf("[SAMPLER] %u samples @ %uus, period %d..%dus, jitter %.1fus RMS, %u missed\n",
+                          s.samples, s.nominalUs, s.minPeriodUs, s.maxPeriodUs, s.jitterRmsUs, s.missed);
+            Serial.printf("[ADC] %u conversions/sample, %u DMA overruns\n", flowAdc.lastCount(), flowAdc.overruns());
+            if (controlEvents.dropped()) Serial.printf("[WARN] %u control events dropped\n", controlEvents.dropped());
+#if WEB_SERVER_ASYNC
+            if (webSocket.droppedEvents()) Serial.printf("[WARN] %u WebSocket events dropped\n", webSocket.droppedEvents());
+#endif
+#if FLOW_CHANNELS == 1
+            if (scope.dropped()) Serial.printf("[WARN] %u scope chunks dropped\n", scope.dropped());
+#endif
+            const ReportByException<STATUS_FIELDS>::Stats &rs = statusReport.stats();
+            Serial.printf("[WS] Status %u published (%u keyframes) / %u suppressed, %u subscribers\n",
+                          rs.sent, rs.keyframes, rs.suppressed, __builtin_popcount(subscriptions.subscribers(TOPIC_STATUS)));
+            for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+                if (!webSocket.clientIsConnected(num)) continue;
+                const auto &qs = sendQueues.stats(num);
+                Serial.printf("[WS] Client %u: %u sent, %u dropped, depth %u (peak %u), write %uus avg / %uus max, wait %ums max\n",
+                              num, qs.sent, qs.dropped, sendQueues.depth(num), qs.maxDepth,
+                              qs.sent ? qs.sendUsTotal / qs.sent : 0, qs.sendUsMax, qs.waitMsMax);
+                sendQueues.resetPeaks(num);
+            }
+            statusReport.resetStats();
+            sampler.resetStats();
         }
     }
 }
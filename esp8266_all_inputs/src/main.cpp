@@ -3,6 +3,17 @@
 #include <WebSocketsServer.h>
 #include <DHT.h>
 #include "index_html.h"
+#if __has_include("index_html_gz.h")
+#include "index_html_gz.h"
+#endif
+#if __has_include("font_woff2.h")
+#include "font_woff2.h"
+#endif
+#include "kalman_filter.h"
+#include "flow_totalizer.h"
+#include "flow_calibration.h"
+#include "json_writer.h"
+#include "client_subscriptions.h"
 
 // WiFi credentials
 const char* ssid = "roku";
@@ -17,24 +28,16 @@ DHT dht(DHTPIN, DHTTYPE);
 #define TRIG_PIN 12
 #define ECHO_PIN 14
 
-// Kalman Filter Class for Flowmeter
-class KalmanFilter {
-  public:
-    KalmanFilter(float q, float r, float p, float initial_value) {
-      _q = q; _r = r; _p = p; _x = initial_value;
-    }
-    float update(float measurement) {
-      _p = _p + _q;
-      _k = _p / (_p + _r);
-      _x = _x + _k * (measurement - _x);
-      _p = (1 - _k) * _p;
-      return _x;
-    }
-  private:
-    float _q, _r, _p, _x, _k;
-};
+// Kalman Filter for Flowmeter (fixed point, the ESP8266 has no FPU)
+KalmanFilter<Q16_16> flowKalman(0.01, 0.1, 1.0, 0.0);
 
-KalmanFilter flowKalman(0.01, 0.1, 1.0, 0.0);
+// Flowmeter curve: linear 4-20 mA -> 0-100 L/min on the 10-bit ADC
+constexpr CalibPoint DEFAULT_CALIBRATION[] = {
+  { 186, 0.0f },   // 4 mA
+  { 930, 100.0f }  // 20 mA
+};
+static_assert(calibValid(DEFAULT_CALIBRATION, 2), "Invalid default calibration");
+FlowCalibration<1024> calibration;
 
 // GPIO Setup (Output pins)
 const int pins[] = {13, 16};
@@ -42,7 +45,7 @@ const int numPins = 2;
 bool pinStates[17] = {false};
 
 // Volume and Time tracking
-float accumulatedVolume = 0;
+FlowTotalizer totalizer; // Exact batch volume in micro-litres
 unsigned long relayStartTime = 0;
 unsigned long lastVolumeCalcTime = 0;
 unsigned long accumulatedTimeMs = 0;
@@ -56,11 +59,87 @@ unsigned long lastFlowTime = 0;
 ESP8266WebServer server(80);
 WebSocketsServer webSocket(81);
 
+// Every WebSocket message is written into this one buffer and sent straight
+// from it, so pushes never touch the heap; the largest (volumeUpdate) is
+// under 140 bytes with every number at JSON_NUMBER_MAX
+char wsJson[160];
+
+// WebSocket topics, each client at the rate it subscribed at. Readings are
+// taken at the fastest rate any subscriber asked for, within what the
+// sensor allows.
+enum Topic : uint8_t { TOPIC_STATUS, TOPIC_FLOW, TOPIC_SENSOR, TOPIC_DISTANCE, TOPIC_COUNT };
+const TopicInfo TOPICS[TOPIC_COUNT] = {
+  {"status", 1000, 100},   // Pin states and batch volume; integrated every 100 ms
+  {"flow", 1000, 50},
+  {"sensor", 2000, 2000},  // DHT11 needs ~2 s between readings
+  {"distance", 500, 100},  // Each reading blocks for up to 30 ms
+};
+ClientSubscriptions<WEBSOCKETS_SERVER_CLIENT_MAX, TOPIC_COUNT> subscriptions;
+
+// Client sets are bitmasks of WebSocket slots
+void sendJson(uint32_t clients, const JsonWriter &json) {
+  if (!json.ok()) return;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (clients & (1u << num)) webSocket.sendTXT(num, json.data(), json.length());
+  }
+}
+
+// New data for a topic: goes to the subscribers whose slot is due, or to
+// all of them when forced (state changes)
+void publishJson(uint8_t topic, const JsonWriter &json, bool force = false) {
+  subscriptions.publish(topic);
+  sendJson(subscriptions.due(topic, millis(), force), json);
+}
+
+JsonWriter pinStateJson(int pin) {
+  JsonWriter json(wsJson, sizeof(wsJson));
+  json.beginObject();
+  json.string("type", "pinState");
+  json.integer("pin", pin);
+  json.boolean("state", pinStates[pin]);
+  json.endObject();
+  return json;
+}
+
 void handleRoot() {
   Serial.printf("HTTP GET request to / from client: %s\n", server.client().remoteIP().toString().c_str());
+  // Gzipped when the build generated it (embed_html.py) and the browser
+  // accepts it; INDEX_HTML as is otherwise. Browsers keep it but
+  // revalidate each load; an unchanged page costs a bare 304.
+#ifdef INDEX_HTML_GZ_H
+  bool gzip = server.header("Accept-Encoding").indexOf("gzip") >= 0;
+  const char *etag = gzip ? INDEX_HTML_GZ_ETAG : INDEX_HTML_ETAG;
+  server.sendHeader("Vary", "Accept-Encoding");
+  server.sendHeader("Cache-Control", "no-cache"); // Changes with the firmware, not on a schedule
+  server.sendHeader("ETag", etag);
+  if (server.header("If-None-Match").indexOf(etag) >= 0) {
+    server.send(304);
+    return;
+  }
+  if (gzip) {
+    server.sendHeader("Content-Encoding", "gzip");
+    server.send_P(200, "text/html", (PGM_P)INDEX_HTML_GZ, INDEX_HTML_GZ_LEN);
+    return;
+  }
+#endif
   server.send_P(200, "text/html", INDEX_HTML);
 }
 
+#ifdef FONT_WOFF2_H
+// Dashboard font, subsetted by embed_html.py when platformio.ini sets
+// custom_embed_font. woff2 is compressed already, so no gzip; cached for a
+// week, then revalidated.
+void handleFont() {
+  server.sendHeader("Cache-Control", "max-age=604800");
+  server.sendHeader("ETag", FONT_WOFF2_ETAG);
+  if (server.header("If-None-Match").indexOf(FONT_WOFF2_ETAG) >= 0) {
+    server.send(304);
+    return;
+  }
+  server.send_P(200, "font/woff2", (PGM_P)FONT_WOFF2, FONT_WOFF2_LEN);
+}
+#endif
+
 void handleNotFound() {
   Serial.printf("HTTP %s request to %s from client: %s (Status: 404)\n", 
                 (server.method() == HTTP_GET) ? "GET" : "POST", 
@@ -83,43 +162,59 @@ float getDistance() {
 
 float getFlow() {
   int raw = analogRead(A0);
-  float raw_flow = (float)(raw - 186) * 100.0 / (930 - 186);
-  if (raw_flow < 0) raw_flow = 0;
-  return flowKalman.update(raw_flow);
+  // Integer from ADC code to filter output: table (0.01 L/min) -> Q16.16
+  int32_t flowQ16 = (int32_t)(((uint32_t)calibration.lookupScaled(raw) << 16) / CALIB_FLOW_SCALE);
+  flowKalman.updateRaw(flowQ16);
+  return flowKalman.value();
 }
 
-void broadcastVolumeUpdate() {
+void sendVolumeUpdate(bool force) {
   unsigned long currentSessionTime = accumulatedTimeMs;
   if (pinStates[13]) {
     currentSessionTime += (millis() - relayStartTime);
   }
   unsigned long elapsedSec = currentSessionTime / 1000;
-  
-  String msg = "{\"type\":\"volumeUpdate\", \"vol\": " + String(accumulatedVolume, 2) + 
-               ", \"target\": " + String(volumeTarget, 2) + 
-               ", \"elapsed\": " + String(elapsedSec) + 
-               ", \"targetReached\": " + String(volumeTargetReached ? "true" : "false") + "}";
-  webSocket.broadcastTXT(msg);
+
+  JsonWriter json(wsJson, sizeof(wsJson));
+  json.beginObject();
+  json.string("type", "volumeUpdate");
+  json.number("vol", totalizer.litres(), 2);
+  json.number("target", volumeTarget, 2);
+  json.integer("elapsed", elapsedSec);
+  json.boolean("targetReached", volumeTargetReached);
+  json.endObject();
+  publishJson(TOPIC_STATUS, json, force);
 }
 
 void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
   switch(type) {
     case WStype_DISCONNECTED:
       Serial.printf("[%u] Disconnected!\n", num);
+      subscriptions.disconnect(num);
       break;
     case WStype_CONNECTED: {
       IPAddress ip = webSocket.remoteIP(num);
       Serial.printf("[%u] Connected from %s\n", num, ip.toString().c_str());
+      subscriptions.connect(num);
       for(int i=0; i<numPins; i++) {
-        String msg = "{\"type\":\"pinState\", \"pin\": " + String(pins[i]) + ", \"state\": " + String(pinStates[pins[i]] ? "true" : "false") + "}";
-        webSocket.sendTXT(num, msg);
+        sendJson(1u << num, pinStateJson(pins[i]));
       }
-      broadcastVolumeUpdate();
+      sendVolumeUpdate(true);
       break;
     }
     case WStype_TEXT: {
       String text = String((char*)payload);
-      if (text.startsWith("toggle:")) {
+      if (text.startsWith("subscribe:")) {
+        // subscribe:<topic>[@<rate>Hz], e.g. subscribe:flow@20Hz
+        int8_t topic = subscriptions.subscribe(num, text.c_str() + 10);
+        if (topic >= 0) {
+          Serial.printf("[%u] Subscribed: %s every %u ms\n", num, TOPICS[topic].name, subscriptions.intervalMs(num, topic));
+        } else {
+          Serial.printf("[%u] Subscription rejected: %s\n", num, text.c_str() + 10);
+        }
+      } else if (text.startsWith("unsubscribe:")) {
+        subscriptions.unsubscribe(num, text.c_str() + 12);
+      } else if (text.startsWith("toggle:")) {
         int pin = text.substring(7).toInt();
         bool allowed = false;
         for(int i=0; i<numPins; i++) {
@@ -133,33 +228,33 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length
              if (pinStates[13]) {
                 // RESUME or START
                 if (volumeTargetReached) {
-                    accumulatedVolume = 0;
+                    totalizer.reset();
                     accumulatedTimeMs = 0;
                     volumeTargetReached = false;
                 }
                 relayStartTime = millis();
                 lastVolumeCalcTime = millis();
+                totalizer.hold(flowKalman.value());
                 Serial.println("Relay ON: Batch operation Running");
              } else {
                 // PAUSE
                 accumulatedTimeMs += (millis() - relayStartTime);
-                Serial.printf("Relay OFF: Paused at %.2f L\n", accumulatedVolume);
+                Serial.printf("Relay OFF: Paused at %.2f L\n", totalizer.litres());
              }
           }
           
-          String msg = "{\"type\":\"pinState\", \"pin\": " + String(pin) + ", \"state\": " + String(pinStates[pin] ? "true" : "false") + "}";
-          webSocket.broadcastTXT(msg);
-          broadcastVolumeUpdate();
+          sendJson(subscriptions.subscribers(TOPIC_STATUS), pinStateJson(pin));
+          sendVolumeUpdate(true);
         }
       } else if (text.startsWith("setTarget:")) {
         float newTarget = text.substring(10).toFloat();
         if (newTarget >= 1.0 && newTarget <= 1000000.0) {
           volumeTarget = newTarget;
           volumeTargetReached = false;
-          broadcastVolumeUpdate();
+          sendVolumeUpdate(true);
         }
       } else if (text.equals("resetBatch")) {
-        accumulatedVolume = 0;
+        totalizer.reset();
         accumulatedTimeMs = 0;
         volumeTargetReached = false;
         if (pinStates[13]) {
@@ -167,7 +262,7 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length
            lastVolumeCalcTime = millis();
         }
         Serial.println("Batch Reset requested");
-        broadcastVolumeUpdate();
+        sendVolumeUpdate(true);
       }
       break;
     }
@@ -178,6 +273,7 @@ void setup() {
   Serial.begin(115200);
   Serial.println();
   dht.begin();
+  calibration.load(DEFAULT_CALIBRATION, 2);
   pinMode(TRIG_PIN, OUTPUT);
   pinMode(ECHO_PIN, INPUT);
   for(int i=0; i<numPins; i++) {
@@ -190,9 +286,15 @@ void setup() {
   Serial.print("IP Address: ");
   Serial.println(WiFi.localIP());
   
+  static const char *headerKeys[] = {"Accept-Encoding", "If-None-Match"};
+  server.collectHeaders(headerKeys, 2);
   server.on("/", handleRoot);
+#ifdef FONT_WOFF2_H
+  server.on("/outfit.woff2", handleFont);
+#endif
   server.onNotFound(handleNotFound);
   server.begin();
+  subscriptions.begin(TOPICS);
   webSocket.begin();
   webSocket.onEvent(webSocketEvent);
   Serial.println("Servers started (HTTP: 80, WS: 81)");
@@ -206,14 +308,14 @@ void loop() {
   if (pinStates[13] && !volumeTargetReached) {
     if (millis() - lastVolumeCalcTime >= 100) {
       float currentFlow = getFlow(); // L/min
-      float timeStepSeconds = (millis() - lastVolumeCalcTime) / 1000.0;
-      float volumeStep = (currentFlow / 60.0) * timeStepSeconds; // Convert L/min to L/sec * sec
-      accumulatedVolume += volumeStep;
+      uint32_t timeStepUs = (millis() - lastVolumeCalcTime) * 1000UL;
+      totalizer.add(currentFlow, timeStepUs);
       lastVolumeCalcTime = millis();
 
       // Check for target completion
-      if (accumulatedVolume >= volumeTarget) {
-        accumulatedVolume = volumeTarget; // Cap at target for display
+      int64_t targetUl = FlowTotalizer::fromLitres(volumeTarget);
+      if (totalizer.microLitres() >= targetUl) {
+        totalizer.set(targetUl); // Cap at target for display
         accumulatedTimeMs += (millis() - relayStartTime); // Final time update
         volumeTargetReached = true;
         pinStates[13] = false;
@@ -221,45 +323,66 @@ void loop() {
         Serial.println("TARGET REACHED: Powering off Relay 13");
         
         // Broadcast final state
-        String msg = "{\"type\":\"pinState\", \"pin\": 13, \"state\": false}";
-        webSocket.broadcastTXT(msg);
-        broadcastVolumeUpdate();
+        sendJson(subscriptions.subscribers(TOPIC_STATUS), pinStateJson(13));
+        sendVolumeUpdate(true);
       }
-      // Broadcast volume update every 1 second to web
+      // Volume update at the fastest subscribed rate (1 s by default)
       static unsigned long lastVolBroadcast = 0;
-      if (millis() - lastVolBroadcast > 1000) {
+      if (millis() - lastVolBroadcast >= subscriptions.fastestMs(TOPIC_STATUS)) {
         lastVolBroadcast = millis();
-        broadcastVolumeUpdate();
+        sendVolumeUpdate(false);
       }
     }
   }
 
-  if (millis() - lastDHTTime > 2000) {
+  // Console output stays at the default rates however fast clients subscribe
+  if (millis() - lastDHTTime >= subscriptions.fastestMs(TOPIC_SENSOR)) {
     lastDHTTime = millis();
     float h = dht.readHumidity();
     float t = dht.readTemperature();
     if (!isnan(h) && !isnan(t)) {
-      String msg = "{\"type\":\"sensor\", \"temp\": " + String(t) + ", \"hum\": " + String(h) + "}";
-      webSocket.broadcastTXT(msg);
+      JsonWriter json(wsJson, sizeof(wsJson));
+      json.beginObject();
+      json.string("type", "sensor");
+      json.number("temp", t, 2);
+      json.number("hum", h, 2);
+      json.endObject();
+      publishJson(TOPIC_SENSOR, json);
       Serial.printf("Sensor: Temp: %.1f °C | Humidity: %.1f %%\n", t, h);
     }
   }
 
-  if (millis() - lastUltraTime > 500) {
+  if (millis() - lastUltraTime >= subscriptions.fastestMs(TOPIC_DISTANCE)) {
     lastUltraTime = millis();
     float dist = getDistance();
     if (dist > 0.5) {
-      String msg = "{\"type\":\"distance\", \"val\": " + String(dist) + "}";
-      webSocket.broadcastTXT(msg);
-      Serial.printf("Distance: %.1f cm\n", dist);
+      JsonWriter json(wsJson, sizeof(wsJson));
+      json.beginObject();
+      json.string("type", "distance");
+      json.number("val", dist, 2);
+      json.endObject();
+      publishJson(TOPIC_DISTANCE, json);
+      static unsigned long lastDistLog = 0;
+      if (millis() - lastDistLog >= TOPICS[TOPIC_DISTANCE].defaultMs) {
+        lastDistLog = millis();
+        Serial.printf("Distance: %.1f cm\n", dist);
+      }
     }
   }
 
-  if (millis() - lastFlowTime > 1000) {
+  if (millis() - lastFlowTime >= subscriptions.fastestMs(TOPIC_FLOW)) {
     lastFlowTime = millis();
     float flow = getFlow();
-    String msg = "{\"type\":\"flow\", \"val\": " + String(flow) + "}";
-    webSocket.broadcastTXT(msg);
-    Serial.printf("Flow: %.1f L/min | Volume: %.2f L\n", flow, accumulatedVolume);
+    JsonWriter json(wsJson, sizeof(wsJson));
+    json.beginObject();
+    json.string("type", "flow");
+    json.number("val", flow, 2);
+    json.endObject();
+    publishJson(TOPIC_FLOW, json);
+    static unsigned long lastFlowLog = 0;
+    if (millis() - lastFlowLog >= TOPICS[TOPIC_FLOW].defaultMs) {
+      lastFlowLog = millis();
+      Serial.printf("Flow: %.1f L/min | Volume: %.2f L\n", flow, totalizer.litres());
+    }
   }
 }
@@ -0,0 +1,123 @@
+#ifndef CLIENT_SEND_QUEUE_H
+#define CLIENT_SEND_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Bounded per-client send queues for the WebSocket server.
+// Producers queue messages instead of writing to sockets, and loop()
+// drains each queue only as fast as that client's socket takes data, so a
+// congested link delays its own client and nobody else.
+// Status messages are superseded by newer ones: a full queue drops its
+// oldest status message. Control messages (acknowledgements, state
+// changes) are never dropped; when one cannot be queued because the queue
+// holds nothing else, push() fails and the caller drops the client rather
+// than let it miss the message silently.
+enum SendClass : uint8_t { SEND_STATUS, SEND_CONTROL };
+
+template <uint8_t CLIENTS, uint8_t DEPTH, uint16_t SIZE>
+class ClientSendQueues {
+    static_assert(DEPTH >= 2, "Need room for a control message behind a status message");
+
+public:
+    struct Message {
+        uint32_t queuedMs;
+        uint16_t len;
+        bool binary;
+        SendClass cls;
+        uint8_t data[SIZE];
+    };
+
+    struct Stats {
+        uint32_t sent;
+        uint32_t dropped;     // Status messages superseded while queued
+        uint32_t sendUsTotal; // Time spent in socket writes
+        uint32_t sendUsMax;
+        uint32_t waitMsMax;   // Queued to written
+        uint8_t maxDepth;
+    };
+
+    ClientSendQueues() {
+        for (uint8_t num = 0; num < CLIENTS; num++) clear(num);
+    }
+
+    bool push(uint8_t num, const void *data, size_t len, bool binary, SendClass cls, uint32_t nowMs) {
+        if (num >= CLIENTS || len > SIZE) return false;
+        Queue &q = _queues[num];
+        if (q.count == DEPTH) {
+            uint8_t victim = 0;
+            while (victim < DEPTH && q.slots[q.order[victim]].cls != SEND_STATUS) victim++;
+            if (victim == DEPTH) {
+                if (cls == SEND_CONTROL) return false;
+                q.stats.dropped++; // Only control queued: the new status goes instead
+                return true;
+            }
+            q.stats.dropped++;
+            remove(q, victim);
+        }
+        Message &m = q.slots[q.order[q.count++]]; // Free slots follow the queued ones
+        m.queuedMs = nowMs;
+        m.len = len;
+        m.binary = binary;
+        m.cls = cls;
+        memcpy(m.data, data, len);
+        if (q.count > q.stats.maxDepth) q.stats.maxDepth = q.count;
+        return true;
+    }
+
+    const Message *front(uint8_t num) const {
+        const Queue &q = _queues[num];
+        return q.count ? &q.slots[q.order[0]] : nullptr;
+    }
+
+    // Records the write of the front message and removes it
+    void sent(uint8_t num, uint32_t sendUs, uint32_t nowMs) {
+        Queue &q = _queues[num];
+        if (!q.count) return;
+        uint32_t waitMs = nowMs - q.slots[q.order[0]].queuedMs;
+        if (waitMs > q.stats.waitMsMax) q.stats.waitMsMax = waitMs;
+        if (sendUs > q.stats.sendUsMax) q.stats.sendUsMax = sendUs;
+        q.stats.sendUsTotal += sendUs;
+        q.stats.sent++;
+        remove(q, 0);
+    }
+
+    // Slots are reused: a new connection starts empty with fresh stats
+    void clear(uint8_t num) {
+        Queue &q = _queues[num];
+        for (uint8_t i = 0; i < DEPTH; i++) q.order[i] = i;
+        q.count = 0;
+        q.stats = Stats();
+    }
+
+    uint8_t depth(uint8_t num) const { return _queues[num].count; }
+    const Stats &stats(uint8_t num) const { return _queues[num].stats; }
+
+    // Peaks restart for the next reporting window; counters keep running
+    void resetPeaks(uint8_t num) {
+        Stats &s = _queues[num].stats;
+        s.sendUsMax = 0;
+        s.waitMsMax = 0;
+        s.maxDepth = _queues[num].count;
+    }
+
+private:
+    struct Queue {
+        Message slots[DEPTH];
+        uint8_t order[DEPTH]; // Queued slots first, oldest first; then the free ones
+        uint8_t count;
+        Stats stats;
+    };
+
+    static void remove(Queue &q, uint8_t index) {
+        uint8_t slot = q.order[index];
+        memmove(&q.order[index], &q.order[index + 1], DEPTH - index - 1);
+        q.order[DEPTH - 1] = slot;
+        q.count--;
+    }
+
+    Queue _queues[CLIENTS];
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef CLIENT_SUBSCRIPTIONS_H
+#define CLIENT_SUBSCRIPTIONS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "text_span.h"
+
+// Per-client WebSocket topic subscriptions with a negotiated rate.
+// A client sends "subscribe:<topic>@<rate>Hz" (or "subscribe:<topic>" for
+// the topic's default rate) and "unsubscribe:<topic>". Until it does, it
+// gets every topic at the default rate, so a dashboard that never asks
+// keeps working unchanged; its first subscribe replaces that default set.
+// A topic without a default rate is opt-in: only clients that ask get it.
+// Producers publish() a topic when it has something new, which marks it
+// pending for every subscriber, and due() returns the subscribers whose
+// interval has run out. Updates faster than a client's rate coalesce: it
+// gets the latest state in its next slot, never a backlog.
+#define SUBSCRIBE_MAX_INTERVAL_MS 60000
+
+struct TopicInfo {
+    const char *name;
+    uint16_t defaultMs; // Interval for clients that did not ask; 0: opt-in
+    uint16_t minMs;     // Fastest the topic can be produced
+};
+
+template <uint8_t CLIENTS, uint8_t TOPICS>
+class ClientSubscriptions {
+    static_assert(CLIENTS <= 32, "Client sets are 32-bit masks");
+
+public:
+    void begin(const TopicInfo *topics) { _topics = topics; }
+
+    // Slots are reused: every connection starts on the default set, with
+    // the current state of each topic pending
+    void connect(uint8_t num) {
+        if (num >= CLIENTS) return;
+        for (uint8_t t = 0; t < TOPICS; t++) {
+            _intervalMs[num][t] = _topics[t].defaultMs;
+            _lastMs[num][t] = 0;
+            if (_topics[t].defaultMs) _pending[t] |= 1u << num;
+        }
+        _chosen &= ~(1u << num);
+    }
+
+    void disconnect(uint8_t num) {
+        if (num >= CLIENTS) return;
+        for (uint8_t t = 0; t < TOPICS; t++) {
+            _intervalMs[num][t] = 0;
+            _pending[t] &= ~(1u << num);
+        }
+    }
+
+    // spec: "flow@20Hz", "flow@0.5Hz" or "flow". Rates are clamped to what
+    // the topic can produce. Returns the topic, or -1 for an unknown topic
+    // or a bad rate.
+    int8_t subscribe(uint8_t num, TextSpan spec) {
+        TextSpan name;
+        bool hasRate = spec.next('@', name) && spec.p;
+        int8_t t = find(name.p, name.len);
+        if (num >= CLIENTS || t < 0) return -1;
+
+        uint32_t interval = _topics[t].defaultMs;
+        if (hasRate) {
+            float hz;
+            if (spec.len < 2 || memcmp(spec.p + spec.len - 2, "Hz", 2) != 0) return -1;
+            if (!parseFloat(TextSpan(spec.p, spec.len - 2), hz) || !(hz > 0)) return -1;
+            float ms = 1000.0f / hz;
+            interval = ms < SUBSCRIBE_MAX_INTERVAL_MS ? (uint32_t)(ms + 0.5f) : SUBSCRIBE_MAX_INTERVAL_MS;
+        }
+        if (interval < _topics[t].minMs) interval = _topics[t].minMs;
+
+        choose(num);
+        _intervalMs[num][t] = interval;
+        _pending[t] |= 1u << num; // Current state in the next slot
+        return t;
+    }
+
+    int8_t subscribe(uint8_t num, const char *spec) { return subscribe(num, TextSpan(spec)); }
+
+    bool unsubscribe(uint8_t num, TextSpan name) {
+        int8_t t = find(name.p, name.len);
+        if (num >= CLIENTS || t < 0) return false;
+        _chosen |= 1u << num; // Keeps the rest of whatever it had
+        _intervalMs[num][t] = 0;
+        _pending[t] &= ~(1u << num);
+        return true;
+    }
+
+    bool unsubscribe(uint8_t num, const char *name) { return unsubscribe(num, TextSpan(name)); }
+
+    // The topic has something new for all its subscribers
+    void publish(uint8_t topic) { _pending[topic] |= subscribers(topic); }
+
+    // Subscribers with an update pending whose interval has run out, or
+    // every pending one when forced (state changes); they count as served
+    uint32_t due(uint8_t topic, uint32_t nowMs, bool force = false) {
+        uint32_t mask = 0;
+        for (uint8_t num = 0; num < CLIENTS; num++) {
+            if (!(_pending[topic] & (1u << num))) continue;
+            if (force || nowMs - _lastMs[num][topic] >= _intervalMs[num][topic]) {
+                _lastMs[num][topic] = nowMs;
+                mask |= 1u << num;
+            }
+        }
+        _pending[topic] &= ~mask;
+        return mask;
+    }
+
+    uint32_t subscribers(uint8_t topic) const {
+        uint32_t mask = 0;
+        for (uint8_t num = 0; num < CLIENTS; num++) {
+            if (_intervalMs[num][topic]) mask |= 1u << num;
+        }
+        return mask;
+    }
+
+    // How often the topic needs producing: the fastest subscriber, or the
+    // default rate when nobody is subscribed
+    uint16_t fastestMs(uint8_t topic) const {
+        uint16_t fastest = 0;
+        for (uint8_t num = 0; num < CLIENTS; num++) {
+            uint16_t ms = _intervalMs[num][topic];
+            if (ms && (!fastest || ms < fastest)) fastest = ms;
+        }
+        return fastest ? fastest : _topics[topic].defaultMs;
+    }
+
+    uint16_t intervalMs(uint8_t num, uint8_t topic) const { return _intervalMs[num][topic]; }
+
+private:
+    int8_t find(const char *name, size_t len) const {
+        for (uint8_t t = 0; t < TOPICS; t++) {
+            if (TextSpan(name, len).equals(_topics[t].name)) return t;
+        }
+        return -1;
+    }
+
+    // The first explicit choice drops the defaults the client never asked for
+    void choose(uint8_t num) {
+        if (_chosen & (1u << num)) return;
+        for (uint8_t t = 0; t < TOPICS; t++) {
+            _intervalMs[num][t] = 0;
+            _pending[t] &= ~(1u << num);
+        }
+        _chosen |= 1u << num;
+    }
+
+    const TopicInfo *_topics = nullptr;
+    uint16_t _intervalMs[CLIENTS][TOPICS] = {}; // 0: not subscribed
+    uint32_t _lastMs[CLIENTS][TOPICS] = {};
+    uint32_t _pending[TOPICS] = {};             // Bit per client
+    uint32_t _chosen = 0;                       // Clients that picked their own topics
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "text_span.h"
+
+// Table-driven parser for the text commands every transport accepts.
+// A command is "<name>" or "<name>:<arg>[:<arg>]". The commands are listed
+// in a const table with each argument's type and range (flow_commands.h),
+// and parseCommand() matches and validates a whole message against it in
+// place over (payload, length): no copies, no String, no allocation.
+// What a command does is up to the caller, which switches on the id, so
+// WebSocket and MQTT share one parser and one set of rules.
+// A frame may carry several commands, one per line, each optionally
+// prefixed with the client's request id: "#17 setTarget:500\n#18 toggle:13".
+#define COMMAND_MAX_ARGS 2
+
+enum ArgType : uint8_t {
+    ARG_NONE,  // No (further) argument
+    ARG_INT,   // Decimal integer within [min, max], compared exactly
+    ARG_FLOAT, // Decimal number within [min, max]
+    ARG_TEXT   // The rest of the message, colons included; last argument only
+};
+
+// Bounds are whole numbers: int64 keeps ARG_INT ranges such as a uint32
+// sequence exact, where a float bound would round 4294967295 up to 2^32
+struct ArgSpec {
+    ArgType type;
+    int64_t min;
+    int64_t max;
+
+    constexpr ArgSpec(ArgType t = ARG_NONE, int64_t lo = 0, int64_t hi = 0) : type{t}, min{lo}, max{hi} {}
+};
+
+struct CommandSpec {
+    const char *name;
+    uint8_t id;
+    ArgSpec args[COMMAND_MAX_ARGS];
+
+    constexpr CommandSpec(const char *n, uint8_t i, ArgSpec a0 = ArgSpec(), ArgSpec a1 = ArgSpec())
+        : name{n}, id{i}, args{a0, a1} {}
+};
+
+struct CommandArg {
+    int64_t i;     // ARG_INT
+    float f;       // ARG_FLOAT, and ARG_INT as a float
+    TextSpan text; // The argument as sent
+};
+
+struct ParsedCommand {
+    const CommandSpec *spec;
+    CommandArg args[COMMAND_MAX_ARGS];
+};
+
+enum ParseStatus : uint8_t {
+    PARSE_OK,
+    PARSE_UNKNOWN,      // No such command
+    PARSE_MISSING,      // Fewer arguments than the command takes
+    PARSE_EXTRA,        // More arguments than the command takes
+    PARSE_BAD_NUMBER,   // Not a decimal number (or not an integer)
+    PARSE_OUT_OF_RANGE
+};
+
+inline const char *parseStatusName(ParseStatus status) {
+    switch (status) {
+        case PARSE_OK: return "ok";
+        case PARSE_UNKNOWN: return "unknown command";
+        case PARSE_MISSING: return "missing argument";
+        case PARSE_EXTRA: return "unexpected argument";
+        case PARSE_BAD_NUMBER: return "bad number";
+        case PARSE_OUT_OF_RANGE: return "out of range";
+    }
+    return "?";
+}
+
+struct CommandLine {
+    TextSpan text; // The command, without the id prefix
+    uint32_t id;
+    bool hasId;
+    bool badId;    // Malformed "#<id>" prefix; text is the whole line
+};
+
+// Splits the next non-empty line off a frame. False at the end of the frame.
+inline bool nextCommandLine(TextSpan &frame, CommandLine &line) {
+    line.badId = false;
+    do {
+        if (!frame.next('\n', line.text)) return false;
+        if (line.text.len && line.text.p[line.text.len - 1] == '\r') line.text.len--;
+    } while (line.text.empty());
+
+    line.id = 0;
+    line.hasId = line.text.p[0] == '#';
+    if (line.hasId) {
+        TextSpan rest(line.text.p + 1, line.text.len - 1), id;
+        int64_t value;
+        if (!rest.next(' ', id) || !rest.p || !parseInt(id, value) || value < 0 || value > UINT32_MAX) {
+            line.badId = true;
+            return true;
+        }
+        line.id = (uint32_t)value;
+        line.text = rest;
+    }
+    return true;
+}
+
+template <size_t N>
+ParseStatus parseCommand(const CommandSpec (&table)[N], TextSpan message, ParsedCommand &out) {
+    TextSpan name;
+    message.next(':', name);
+    out.spec = nullptr;
+    for (size_t c = 0; c < N; c++) {
+        if (name.equals(table[c].name)) {
+            out.spec = &table[c];
+            break;
+        }
+    }
+    if (!out.spec) return PARSE_UNKNOWN;
+
+    for (uint8_t a = 0; a < COMMAND_MAX_ARGS; a++) {
+        const ArgSpec &spec = out.spec->args[a];
+        CommandArg &arg = out.args[a];
+        arg = CommandArg();
+        if (spec.type == ARG_NONE) break;
+        if (spec.type == ARG_TEXT) {
+            arg.text = message;
+            message = TextSpan();
+            break;
+        }
+        if (!message.next(':', arg.text)) return PARSE_MISSING;
+        if (spec.type == ARG_INT) {
+            if (!parseInt(arg.text, arg.i)) return PARSE_BAD_NUMBER;
+            arg.f = (float)arg.i;
+            if (arg.i < spec.min || arg.i > spec.max) return PARSE_OUT_OF_RANGE;
+        } else {
+            if (!parseFloat(arg.text, arg.f)) return PARSE_BAD_NUMBER;
+            if (arg.f < (float)spec.min || arg.f > (float)spec.max) return PARSE_OUT_OF_RANGE;
+        }
+    }
+    return message.p ? PARSE_EXTRA : PARSE_OK;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdint.h>
+
+// Sequence numbers for what the WebSocket server sends, and a short log of
+// the discrete events among them so a reconnecting client can resume.
+// Every status publish takes next() and every logged event takes the
+// number after it, so a client that remembers the highest number it saw
+// can send "resume:<seq>" and get only the logged events it missed.
+// Status needs no replay: the fresh snapshot that follows supersedes it.
+// The server replays one event at a time with eventAfter(), as the client's
+// send queue makes room, so the log can be longer than the queue.
+// Numbering starts at a random value each boot, so a number from before a
+// reboot almost certainly falls outside the log and forces a resync
+// instead of replaying the wrong events. Comparisons are modulo 2^32.
+template <typename T, uint8_t N>
+class EventLog {
+public:
+    void begin(uint32_t firstSeq) {
+        _seq = firstSeq - 1;
+        _evictedSeq = _seq;
+        _count = 0;
+        _head = 0;
+    }
+
+    uint32_t seq() const { return _seq; }
+
+    // A number for a message that is not logged (status publish)
+    uint32_t next() { return ++_seq; }
+
+    uint32_t append(const T &event) {
+        Entry &e = _entries[_head];
+        if (_count == N) _evictedSeq = e.seq; // Overwrites the oldest
+        else _count++;
+        e.seq = ++_seq;
+        e.event = event;
+        _head = (_head + 1) % N;
+        return e.seq;
+    }
+
+    // Whether every event after `after` is still here: false when some
+    // were overwritten, or `after` is not a number this boot handed out
+    bool covers(uint32_t after) const {
+        return (int32_t)(_seq - after) >= 0 && (int32_t)(after - _evictedSeq) >= 0;
+    }
+
+    // The oldest logged event after `after`; false when there is none
+    bool eventAfter(uint32_t after, uint32_t &seq, T &event) const {
+        for (uint8_t i = 0; i < _count; i++) {
+            const Entry &e = _entries[(_head + N - _count + i) % N];
+            if ((int32_t)(e.seq - after) > 0) {
+                seq = e.seq;
+                event = e.event;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Entry {
+        uint32_t seq;
+        T event;
+    };
+
+    Entry _entries[N];
+    uint32_t _seq = 0;
+    uint32_t _evictedSeq = 0; // Newest number no longer in the log
+    uint8_t _count = 0;
+    uint8_t _head = 0;        // Next slot to write
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef FLOW_CALIBRATION_H
+#define FLOW_CALIBRATION_H
+
+#include <stdint.h>
+#include "text_span.h"
+
+// Piecewise-linear sensor calibration, raw ADC counts -> L/min.
+// The breakpoints are expanded once into a table indexed directly by the
+// ADC code, so converting a sample costs two table reads and a lerp (for
+// fractional, oversampled codes) regardless of how many breakpoints the
+// curve has. Entries are stored in 0.01 L/min steps to keep the 12-bit
+// table at 8 KB.
+#define CALIB_MAX_POINTS 16
+#define CALIB_FLOW_SCALE 100 // Table units per L/min
+
+struct CalibPoint {
+    uint16_t raw;
+    float flow; // L/min
+};
+
+// Breakpoints must be strictly increasing in raw counts and non-negative in flow
+constexpr bool calibValid(const CalibPoint *points, uint8_t count, uint8_t i = 1) {
+    return count >= 2 && count <= CALIB_MAX_POINTS && points[0].flow >= 0 &&
+           (i >= count || (points[i].raw > points[i - 1].raw && points[i].flow >= 0 &&
+                           calibValid(points, count, i + 1)));
+}
+
+// Parses "raw:flow,raw:flow,..." into points. Returns the point count, or
+// 0 if the text is malformed. Validate the result with calibValid().
+inline uint8_t parseCalibration(TextSpan text, CalibPoint *points) {
+    uint8_t count = 0;
+    TextSpan point, raw;
+    while (text.next(',', point)) {
+        if (count == CALIB_MAX_POINTS) return 0;
+        int64_t code;
+        float flow;
+        if (!point.next(':', raw) || !parseInt(raw, code) || code < 0 || code > 65535) return 0;
+        if (!parseFloat(point, flow)) return 0;
+        points[count].raw = (uint16_t)code;
+        points[count].flow = flow;
+        count++;
+    }
+    return count;
+}
+
+template <uint16_t ADC_CODES>
+class FlowCalibration {
+public:
+    bool load(const CalibPoint *points, uint8_t count) {
+        if (!calibValid(points, count)) return false;
+        for (uint8_t i = 0; i < count; i++) _points[i] = points[i];
+        _count = count;
+
+        // Flat below the first and above the last breakpoint
+        uint8_t seg = 0;
+        for (uint32_t code = 0; code < ADC_CODES; code++) {
+            while (seg + 2 < count && code >= points[seg + 1].raw) seg++;
+            const CalibPoint &a = points[seg];
+            const CalibPoint &b = points[seg + 1];
+            float flow;
+            if (code <= a.raw) flow = a.flow;
+            else if (code >= b.raw) flow = b.flow;
+            else flow = a.flow + (b.flow - a.flow) * (code - a.raw) / (b.raw - a.raw);
+            float scaled = flow * CALIB_FLOW_SCALE + 0.5f;
+            _lut[code] = scaled > 65535 ? 65535 : (uint16_t)scaled;
+        }
+        return true;
+    }
+
+    // Integer path for targets without an FPU
+    uint16_t lookupScaled(uint16_t raw) const {
+        return _lut[raw < ADC_CODES ? raw : ADC_CODES - 1];
+    }
+
+    float lookup(float raw) const {
+        if (raw <= 0) return _lut[0] / (float)CALIB_FLOW_SCALE;
+        if (raw >= ADC_CODES - 1) return _lut[ADC_CODES - 1] / (float)CALIB_FLOW_SCALE;
+        uint16_t code = (uint16_t)raw;
+        float frac = raw - code;
+        return (_lut[code] + (_lut[code + 1] - _lut[code]) * frac) / CALIB_FLOW_SCALE;
+    }
+
+    const CalibPoint *points() const { return _points; }
+    uint8_t count() const { return _count; }
+
+private:
+    uint16_t _lut[ADC_CODES];
+    CalibPoint _points[CALIB_MAX_POINTS];
+    uint8_t _count = 0;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef FLOW_COMMANDS_H
+#define FLOW_COMMANDS_H
+
+#include "command_parser.h"
+
+// The command table both sketches (and the native tests) parse against:
+// "<name>[:<arg>[:<arg>]]", the same over every transport. Names and
+// argument ranges are checked by parseCommand(); the sketch's runCommand()
+// applies the state rules. FLOW_CHANNELS selects the single-line batch
+// commands or the per-channel ones, as in the sketch.
+#ifndef FLOW_CHANNELS
+#define FLOW_CHANNELS 1
+#endif
+
+enum CommandOp : uint8_t {
+    OP_FORMAT,      // format:bin (WebSocket session)
+    OP_RESUME,      // resume:<seq> (WebSocket session)
+    OP_SUBSCRIBE,   // subscribe:<topic>[@<rate>Hz] (WebSocket session)
+    OP_UNSUBSCRIBE, // unsubscribe:<topic> (WebSocket session)
+    OP_HISTORY,     // history (WebSocket session)
+    OP_TOGGLE,
+    OP_SET_RELAY,
+    OP_SET_TARGET,
+    OP_RESET_BATCH,
+    OP_SET_CALIB,   // setCalib:raw:flow,raw:flow,... (ADC counts : L/min)
+    OP_RESET_CALIB,
+    OP_CH_TOGGLE,
+    OP_CH_RELAY,
+    OP_CH_TARGET,
+    OP_CH_RESET
+};
+
+const CommandSpec COMMANDS[] = {
+    {"format", OP_FORMAT, {ARG_TEXT}},
+    {"resume", OP_RESUME, {ARG_INT, 0, UINT32_MAX}},
+    {"subscribe", OP_SUBSCRIBE, {ARG_TEXT}},
+    {"unsubscribe", OP_UNSUBSCRIBE, {ARG_TEXT}},
+    {"history", OP_HISTORY},
+    {"toggle", OP_TOGGLE, {ARG_INT, 0, 39}},
+    {"setCalib", OP_SET_CALIB, {ARG_TEXT}},
+    {"resetCalib", OP_RESET_CALIB},
+#if FLOW_CHANNELS > 1
+    {"chToggle", OP_CH_TOGGLE, {ARG_INT, 0, FLOW_CHANNELS - 1}},
+    {"chRelay", OP_CH_RELAY, {ARG_INT, 0, FLOW_CHANNELS - 1}, {ARG_INT, 0, 1}},
+    {"chTarget", OP_CH_TARGET, {ARG_INT, 0, FLOW_CHANNELS - 1}, {ARG_FLOAT, 0, 1000000}},
+    {"chReset", OP_CH_RESET, {ARG_INT, 0, FLOW_CHANNELS - 1}},
+#else
+    {"setRelay", OP_SET_RELAY, {ARG_INT, 0, 1}},
+    {"setTarget", OP_SET_TARGET, {ARG_FLOAT, 0, 1000000}},
+    {"resetBatch", OP_RESET_BATCH},
+#endif
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef FLOW_TOTALIZER_H
+#define FLOW_TOTALIZER_H
+
+#include <stdint.h>
+
+// Exact volume totalizer.
+// Volume is counted in integer micro-litres (int64, ~9.2e6 m3 of range)
+// using trapezoidal integration of flow samples quantised to mL/min. The
+// division remainder is carried between samples, so no increment is ever
+// rounded away no matter how small it is relative to the running total;
+// the only float work left is converting the incoming flow and the
+// display/target values.
+class FlowTotalizer {
+public:
+    // Integrates the interval that ends at this sample
+    void add(float flowLpm, uint32_t dtUs) { addMilli(toMilliLpm(flowLpm), dtUs); }
+
+    void addMilli(int32_t flowMlpm, uint32_t dtUs) {
+        if (_primed) integrate(_microLitres, _remainder, _lastMlpm, flowMlpm, dtUs);
+        _lastMlpm = flowMlpm;
+        _primed = true;
+    }
+
+    // Volume measured directly (pulse meters); flow still feeds hold()
+    void addMicroLitres(int64_t microLitres) { _microLitres += microLitres; }
+
+    // One trapezoid step on caller-owned storage (used by the channel bank)
+    static void integrate(int64_t &microLitres, int64_t &remainder, int32_t f0Mlpm, int32_t f1Mlpm, uint32_t dtUs) {
+        // (f0 + f1) / 2 [mL/min] * dt [us] = (f0 + f1) * dt / 120000 [uL]
+        int64_t num = (int64_t)(f0Mlpm + f1Mlpm) * dtUs + remainder;
+        microLitres += num / 120000;
+        remainder = num % 120000;
+    }
+
+    // Records a sample without integrating (pump off), so the next add()
+    // starts its trapezoid from the current flow
+    void hold(float flowLpm) {
+        _lastMlpm = toMilliLpm(flowLpm);
+        _primed = true;
+    }
+
+    void reset() { set(0); }
+
+    void set(int64_t microLitres) {
+        _microLitres = microLitres;
+        _remainder = 0;
+    }
+
+    int64_t microLitres() const { return _microLitres; }
+    float litres() const { return _microLitres * 1e-6f; }
+
+    static int64_t fromLitres(float litres) { return (int64_t)((double)litres * 1e6 + 0.5); }
+    static int32_t toMilliLpm(float flowLpm) { return (int32_t)(flowLpm * 1000.0f + 0.5f); }
+
+private:
+    int64_t _microLitres = 0;
+    int64_t _remainder = 0;
+    int32_t _lastMlpm = 0;
+    bool _primed = false;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef HISTORY_RING_H
+#define HISTORY_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "status_frame.h"
+
+// Recent flow and volume, one point per period, for the dashboard's trend
+// chart. loop() feeds every status reading it takes to sample(); the flow
+// readings are averaged over each period and the volume at its end is
+// kept. The newest N points live in a fixed ring laid out exactly as the
+// wire message (header, then the points), so a new client is sent the
+// history straight from here with no copy and no allocation.
+// While a transfer is in progress the caller passes hold = true and the
+// ring does not change under it; the readings keep accumulating and go
+// into the next point once the hold is released.
+template <uint16_t N>
+class HistoryRing {
+public:
+    void begin(uint32_t periodMs, uint32_t nowMs) {
+        _blob.header.version = STATUS_FRAME_VERSION;
+        _blob.header.type = FRAME_HISTORY;
+        _blob.header.count = 0;
+        _blob.header.oldest = 0;
+        _blob.header.periodMs = periodMs;
+        _blob.header.ageMs = 0;
+        _head = 0;
+        _flowSum = 0;
+        _readings = 0;
+        _pointMs = nowMs;
+    }
+
+    void sample(float flow, float volume, uint32_t nowMs, bool hold) {
+        _flowSum += flow;
+        _readings++;
+        _volume = volume;
+        if (hold || nowMs - _pointMs < _blob.header.periodMs) return;
+
+        float mean = _flowSum / _readings * HISTORY_FLOW_SCALE;
+        HistoryPoint &p = _blob.points[_head];
+        p.flow = mean <= 0 ? 0 : mean >= 65535 ? 65535 : (uint16_t)(mean + 0.5f);
+        p.volume = _volume;
+        _head = (_head + 1) % N;
+        if (_blob.header.count < N) _blob.header.count++;
+        _blob.header.oldest = _blob.header.count < N ? 0 : _head;
+        _flowSum = 0;
+        _readings = 0;
+        _pointMs = nowMs;
+    }
+
+    uint16_t count() const { return _blob.header.count; }
+
+    // The wire message, header and filled points; stamp() brings its age
+    // up to date before a transfer starts
+    void stamp(uint32_t nowMs) { _blob.header.ageMs = nowMs - _pointMs; }
+    const uint8_t *message() const { return (const uint8_t *)&_blob; }
+    size_t messageBytes() const { return sizeof(HistoryHeader) + _blob.header.count * sizeof(HistoryPoint); }
+    static constexpr size_t maxMessageBytes() { return sizeof(HistoryHeader) + N * sizeof(HistoryPoint); }
+
+private:
+    struct __attribute__((packed)) Blob {
+        HistoryHeader header;
+        HistoryPoint points[N];
+    };
+
+    Blob _blob;
+    uint16_t _head = 0;   // Next point to write
+    float _flowSum = 0;
+    uint32_t _readings = 0;
+    float _volume = 0;
+    uint32_t _pointMs = 0; // When the newest point was taken
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Allocation-free JSON writer for the status messages.
+// Writes one flat object (scalars and arrays of numbers) into a buffer the
+// caller owns and reuses, so a status push does no heap work at all: keys
+// are string literals whose length is a compile-time constant, and numbers
+// are formatted with integer arithmetic to a fixed number of decimals (no
+// printf, no dtoa). Every value is at most JSON_NUMBER_MAX characters, so a
+// message's worst-case size follows from its field list.
+// A value that does not fit marks the writer failed instead of sending a
+// truncated object; check ok() before using data().
+// Strings are written as given: pass literals that need no escaping.
+#define JSON_NUMBER_MAX 20 // INT64_MIN; floats stop at 18 ("-" + 16 digits + ".")
+
+class JsonWriter {
+public:
+    JsonWriter(char *buffer, size_t size) : _buf(buffer), _size(size) {}
+
+    void beginObject() { put('{'); }
+    void endObject() {
+        put('}');
+        if (_ok && _len < _size) _buf[_len] = '\0'; // Usable as a C string too
+        else _ok = false;
+    }
+
+    template <size_t K>
+    void string(const char (&k)[K], const char *value) {
+        key(k);
+        put('"');
+        append(value, strlen(value));
+        put('"');
+    }
+
+    template <size_t K>
+    void boolean(const char (&k)[K], bool value) {
+        key(k);
+        if (value) append("true", 4);
+        else append("false", 5);
+    }
+
+    template <size_t K>
+    void integer(const char (&k)[K], int64_t value) {
+        key(k);
+        writeInteger(value);
+    }
+
+    template <size_t K>
+    void number(const char (&k)[K], float value, uint8_t decimals) {
+        key(k);
+        writeNumber(value, decimals);
+    }
+
+    template <size_t K>
+    void beginArray(const char (&k)[K]) {
+        key(k);
+        put('[');
+        _first = true;
+    }
+    void item(float value, uint8_t decimals) {
+        separator();
+        writeNumber(value, decimals);
+    }
+    void item(int64_t value) {
+        separator();
+        writeInteger(value);
+    }
+    void endArray() {
+        put(']');
+        _first = false;
+    }
+
+    bool ok() const { return _ok; }
+    const char *data() const { return _buf; }
+    size_t length() const { return _len; }
+
+private:
+    template <size_t K>
+    void key(const char (&k)[K]) {
+        separator();
+        put('"');
+        append(k, K - 1);
+        put('"');
+        put(':');
+    }
+
+    // Every value after the first in an object or array gets a comma
+    void separator() {
+        if (_len > 0 && !_first) put(',');
+        _first = false;
+    }
+
+    void writeInteger(int64_t value) {
+        char digits[20];
+        uint8_t n = 0;
+        uint64_t mag = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+        if (mag <= UINT32_MAX) {
+            // 32-bit division is native on both targets; 64-bit is a libcall
+            uint32_t m = (uint32_t)mag;
+            do { digits[n++] = '0' + m % 10; m /= 10; } while (m);
+        } else {
+            do { digits[n++] = '0' + mag % 10; mag /= 10; } while (mag);
+        }
+        if (value < 0) put('-');
+        while (n) put(digits[--n]);
+    }
+
+    // Rounded to a fixed number of decimals; NaN, infinities and values too
+    // large to scale become null (JSON has no representation for them)
+    void writeNumber(float value, uint8_t decimals) {
+        static const uint32_t scales[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+        if (decimals > 6) decimals = 6;
+        double scaled = (double)value * scales[decimals];
+        if (!(scaled > -9.0e15 && scaled < 9.0e15)) {
+            append("null", 4);
+            return;
+        }
+        int64_t fixed = (int64_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+        if (fixed < 0) {
+            put('-');
+            fixed = -fixed;
+        }
+        writeInteger(fixed / scales[decimals]);
+        if (decimals == 0) return;
+        put('.');
+        uint32_t frac = (uint32_t)(fixed % scales[decimals]);
+        for (uint32_t div = scales[decimals] / 10; div > 0; div /= 10) {
+            put('0' + (frac / div) % 10);
+        }
+    }
+
+    void put(char c) {
+        if (_len < _size) _buf[_len++] = c;
+        else _ok = false;
+    }
+
+    void append(const char *s, size_t n) {
+        if (n > _size - _len) {
+            _ok = false;
+            _len = _size;
+            return;
+        }
+        memcpy(_buf + _len, s, n);
+        _len += n;
+    }
+
+    char *_buf;
+    size_t _size;
+    size_t _len = 0;
+    bool _first = true;
+    bool _ok = true;
+};
+
+#endif
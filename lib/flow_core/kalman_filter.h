@@ -0,0 +1,101 @@
+#ifndef KALMAN_FILTER_H
+#define KALMAN_FILTER_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Scalar Kalman filter for a slowly varying signal (random walk with
+// process noise q and measurement noise r).
+// With constant q and r the gain converges to a fixed value, so the filter
+// runs the full covariance recursion only until it settles and then
+// switches to the steady-state gain, which is computed by constexpr and
+// folded into the constant-initialised global at compile time. After
+// convergence an update is one multiply-add, in float or Q16.16.
+
+#define KALMAN_GAIN_EPSILON 1e-5f
+
+// Newton iteration usable in a C++11 constexpr context
+constexpr double kalmanSqrtStep(double x, double guess, int iterations) {
+    return iterations == 0 ? guess : kalmanSqrtStep(x, 0.5 * (guess + x / guess), iterations - 1);
+}
+
+constexpr double kalmanSqrt(double x) {
+    return x <= 0 ? 0 : kalmanSqrtStep(x, x > 1 ? x : 1.0, 64);
+}
+
+// Steady-state a priori covariance solves P = q + P*r / (P + r)
+constexpr double kalmanSteadyPrior(double q, double r) {
+    return (q + kalmanSqrt(q * q + 4 * q * r)) / 2;
+}
+
+constexpr float kalmanSteadyGain(double q, double r) {
+    return (float)(kalmanSteadyPrior(q, r) / (kalmanSteadyPrior(q, r) + r));
+}
+
+// Numeric representations
+struct Q16_16 {}; // Tag: signed 16.16 fixed point stored in an int32_t
+
+template <typename T> struct KalmanMath;
+
+template <> struct KalmanMath<float> {
+    typedef float value_type;
+    static constexpr value_type fromFloat(float v) { return v; }
+    static constexpr float toFloat(value_type v) { return v; }
+    static value_type blend(value_type x, value_type k, value_type z) { return x + k * (z - x); }
+};
+
+template <> struct KalmanMath<Q16_16> {
+    typedef int32_t value_type;
+    static constexpr value_type fromFloat(float v) { return (int32_t)(v * 65536.0f + (v >= 0 ? 0.5f : -0.5f)); }
+    static constexpr float toFloat(value_type v) { return v / 65536.0f; }
+    static value_type blend(value_type x, value_type k, value_type z) {
+        return x + (int32_t)(((int64_t)k * (z - x) + 0x8000) >> 16);
+    }
+};
+
+template <typename T = float>
+class KalmanFilter {
+    typedef KalmanMath<T> M;
+public:
+    typedef typename M::value_type value_type;
+
+    constexpr KalmanFilter(float q, float r, float p, float initial)
+        : _q(q), _r(r), _p(p), _kss(M::fromFloat(kalmanSteadyGain(q, r))),
+          _k(M::fromFloat(0)), _x(M::fromFloat(initial)), _converged(false) {}
+
+    float update(float measurement) {
+        return M::toFloat(updateRaw(M::fromFloat(measurement)));
+    }
+
+    // Update in the native representation, avoiding float conversions on
+    // targets without an FPU
+    value_type updateRaw(value_type measurement) {
+        if (!_converged) converge();
+        _x = M::blend(_x, _k, measurement);
+        return _x;
+    }
+
+    float value() const { return M::toFloat(_x); }
+    float gain() const { return M::toFloat(_k); }
+    bool converged() const { return _converged; }
+
+private:
+    // Full covariance recursion for the start-up transient, identical to the
+    // original float filter until the gain lands on the steady-state value
+    void converge() {
+        _p = _p + _q;
+        float k = _p / (_p + _r);
+        _p = (1 - k) * _p;
+        _k = M::fromFloat(k);
+        if (fabsf(k - M::toFloat(_kss)) < KALMAN_GAIN_EPSILON) {
+            _k = _kss;
+            _converged = true;
+        }
+    }
+
+    float _q, _r, _p;
+    value_type _kss, _k, _x;
+    bool _converged;
+};
+
+#endif
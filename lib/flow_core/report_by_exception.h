@@ -0,0 +1,65 @@
+#ifndef REPORT_BY_EXCEPTION_H
+#define REPORT_BY_EXCEPTION_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// Report-by-exception gate for periodic status pushes.
+// Every field has a deadband. A report is due only when some field has
+// moved beyond its deadband since the last report that actually went out,
+// or when the keyframe interval has run out, so an idle system goes quiet
+// while a lost frame or a missed change still converges within one
+// keyframe. A zero deadband (flags, whole seconds) reports any change.
+template <uint8_t N>
+class ReportByException {
+public:
+    struct Stats {
+        uint32_t sent;
+        uint32_t suppressed;
+        uint32_t keyframes; // Sent only because the keyframe interval ran out
+    };
+
+    void begin(const float *deadbands, uint32_t keyframeMs) {
+        memcpy(_deadbands, deadbands, sizeof(_deadbands));
+        _keyframeMs = keyframeMs;
+    }
+
+    // Counts the check as suppressed when nothing is due
+    bool due(const float *values, uint32_t nowMs) {
+        if (!_primed) return true;
+        for (uint8_t i = 0; i < N; i++) {
+            if (fabsf(values[i] - _sentValues[i]) > _deadbands[i]) return true;
+        }
+        if (nowMs - _lastSentMs >= _keyframeMs) {
+            _stats.keyframes++;
+            return true;
+        }
+        _stats.suppressed++;
+        return false;
+    }
+
+    // Records what went out, whether due() asked for it or not
+    void sent(const float *values, uint32_t nowMs) {
+        memcpy(_sentValues, values, sizeof(_sentValues));
+        _lastSentMs = nowMs;
+        _primed = true;
+        _stats.sent++;
+    }
+
+    // Makes the next due() true, e.g. for a newly connected client
+    void force() { _primed = false; }
+
+    const Stats &stats() const { return _stats; }
+    void resetStats() { _stats = Stats(); }
+
+private:
+    float _deadbands[N] = {};
+    float _sentValues[N] = {};
+    uint32_t _keyframeMs = 0;
+    uint32_t _lastSentMs = 0;
+    bool _primed = false;
+    Stats _stats = {};
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SCOPE_CAPTURE_H
+#define SCOPE_CAPTURE_H
+
+#include <atomic>
+#include <stdint.h>
+#include "spsc_ring.h"
+#include "status_frame.h"
+
+// On-demand capture of the flow filter's input and output at the control
+// rate, for the dashboard's diagnostic scope.
+// The control task appends one pair per tick to a chunk it owns and hands
+// the chunk over when it is full, or after SCOPE_CHUNK_MAX_MS at low
+// sample rates. A ring that is still full drops the new chunk whole: the
+// control task never waits, and the chunk sequence shows the gap.
+// Capture only runs while enabled (someone is watching).
+#define SCOPE_RING_CHUNKS 8
+
+class ScopeCapture {
+public:
+    // Consumer side
+    void setEnabled(bool on) { _enabled.store(on, std::memory_order_relaxed); }
+    bool pop(ScopeChunk &chunk) { return _ring.pop(chunk); }
+    uint32_t dropped() const { return _ring.dropped(); }
+
+    // Producer side (control task), once per tick
+    void add(float raw, float filtered, uint32_t periodUs, int64_t nowUs) {
+        if (!_enabled.load(std::memory_order_relaxed)) {
+            _chunk.count = 0;
+            return;
+        }
+        if (_chunk.count == 0) {
+            _chunkStartUs = nowUs;
+            _chunk.periodUs = periodUs;
+        }
+        _chunk.samples[_chunk.count][0] = raw;
+        _chunk.samples[_chunk.count][1] = filtered;
+        _chunk.count++;
+        if (_chunk.count == SCOPE_CHUNK_SAMPLES || nowUs - _chunkStartUs >= SCOPE_CHUNK_MAX_MS * 1000LL) {
+            _chunk.version = STATUS_FRAME_VERSION;
+            _chunk.type = FRAME_SCOPE;
+            _chunk.seq = _seq++;
+            _ring.push(_chunk);
+            _chunk.count = 0;
+        }
+    }
+
+private:
+    std::atomic<bool> _enabled{false};
+    ScopeChunk _chunk = {};
+    int64_t _chunkStartUs = 0;
+    uint32_t _seq = 0;
+    SpscRing<ScopeChunk, SCOPE_RING_CHUNKS> _ring;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+// Single-writer sequence lock for sharing a small POD snapshot between cores.
+// The writer never blocks: it bumps the sequence to odd, copies the value
+// in and bumps it back to even. Readers copy the value out and retry only
+// if a publish overlapped the copy, so they never take a lock and can never
+// observe a torn mix of two publishes.
+template <typename T>
+class SeqLock {
+public:
+    // Must only be called from one task
+    void write(const T &value) {
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy((void *)&_data, &value, sizeof(T));
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    T read() const {
+        T out;
+        uint32_t before, after;
+        do {
+            before = _seq.load(std::memory_order_acquire);
+            memcpy(&out, (const void *)&_data, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = _seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        return out;
+    }
+
+    // Number of completed publishes
+    uint32_t version() const { return _seq.load(std::memory_order_acquire) >> 1; }
+
+private:
+    std::atomic<uint32_t> _seq{0};
+    volatile T _data{};
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef STATUS_FRAME_H
+#define STATUS_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary WebSocket status frame.
+// A client that sends "format:bin" after connecting receives this packed
+// struct as a binary frame instead of the JSON status text: 27 bytes
+// instead of ~200, filled by plain stores with no formatting or heap use,
+// and decoded in the dashboard with a DataView. The ESP32 is
+// little-endian, so the in-memory layout is the wire layout.
+// Bump STATUS_FRAME_VERSION on any layout change; the dashboard ignores
+// versions it does not know.
+#define STATUS_FRAME_VERSION 2
+#define STATUS_FRAME_INTERVAL_MS 50 // Status is checked, and can be subscribed to, at up to 20 Hz
+
+// Frame types (second byte)
+#define FRAME_STATUS 1
+#define FRAME_SCOPE 2
+#define FRAME_HISTORY 3
+
+// StatusFrame::flags
+#define STATUS_FLAG_RELAY 0x01
+#define STATUS_FLAG_VALVE 0x02
+#define STATUS_FLAG_TARGET_REACHED 0x04
+
+struct __attribute__((packed)) StatusFrame {
+    uint8_t version;
+    uint8_t type;
+    uint8_t flags;
+    float flow;       // L/min
+    float volume;     // L
+    float target;     // L
+    uint32_t elapsed; // Batch pump time, s
+    uint32_t uptime;  // s
+    uint32_t seq;     // Publish sequence number, see event_log.h
+};
+static_assert(sizeof(StatusFrame) == 27, "StatusFrame wire layout changed");
+
+// Diagnostic waveform chunk: consecutive control-loop samples of the flow
+// filter's input (calibrated, unfiltered) and output, both in L/min. seq
+// counts every chunk the control task produced, so a gap on the client
+// means whole chunks were dropped. Only the first `count` sample pairs go
+// on the wire.
+#define SCOPE_CHUNK_SAMPLES 64
+#define SCOPE_CHUNK_MAX_MS 100 // A partial chunk is shipped after this long
+
+struct __attribute__((packed)) ScopeChunk {
+    uint8_t version;
+    uint8_t type;
+    uint16_t count;
+    uint32_t seq;
+    uint32_t periodUs; // Nominal sample spacing
+    float samples[SCOPE_CHUNK_SAMPLES][2]; // {raw, filtered}
+};
+static_assert(offsetof(ScopeChunk, samples) == 12, "ScopeChunk wire layout changed");
+
+inline size_t scopeChunkBytes(const ScopeChunk &chunk) {
+    return offsetof(ScopeChunk, samples) + chunk.count * sizeof(chunk.samples[0]);
+}
+
+// Trend history (history_ring.h): a header, then `count` points one period
+// apart. Point i in time order is points[(oldest + i) % count], so the ring
+// goes on the wire as it sits in memory. ageMs is how long ago the newest
+// point was taken.
+#define HISTORY_FLOW_SCALE 100 // HistoryPoint::flow counts per L/min
+
+struct __attribute__((packed)) HistoryPoint {
+    uint16_t flow; // Mean over the period, L/min * HISTORY_FLOW_SCALE
+    float volume;  // L, at the end of the period
+};
+
+struct __attribute__((packed)) HistoryHeader {
+    uint8_t version;
+    uint8_t type;
+    uint16_t count;
+    uint16_t oldest;
+    uint32_t periodMs;
+    uint32_t ageMs;
+};
+static_assert(sizeof(HistoryPoint) == 6 && sizeof(HistoryHeader) == 14, "History wire layout changed");
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef TEXT_SPAN_H
+#define TEXT_SPAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Read-only view of part of a message, for parsing network payloads in
+// place: WebSocket and MQTT hand over (payload, length), which need not be
+// NUL-terminated, and nothing here copies or allocates.
+struct TextSpan {
+    const char *p;
+    size_t len;
+
+    TextSpan() : p(nullptr), len(0) {}
+    TextSpan(const char *text, size_t n) : p(text), len(n) {}
+    explicit TextSpan(const char *text) : p(text), len(strlen(text)) {}
+
+    bool empty() const { return len == 0; }
+    bool equals(const char *s) const { return strlen(s) == len && memcmp(p, s, len) == 0; }
+
+    // Everything before the first `sep` (or all of it) goes to head, and the
+    // span keeps what follows the separator. False once nothing is left.
+    bool next(char sep, TextSpan &head) {
+        if (!p) return false;
+        const char *at = (const char *)memchr(p, sep, len);
+        if (!at) {
+            head = *this;
+            *this = TextSpan();
+            return true;
+        }
+        head = TextSpan(p, at - p);
+        len -= at - p + 1;
+        p = at + 1;
+        return true;
+    }
+};
+
+// Strict decimal integer: optional '-', digits, nothing else
+inline bool parseInt(TextSpan s, int64_t &out) {
+    size_t i = 0;
+    bool neg = s.len && s.p[0] == '-';
+    if (neg) i++;
+    if (i == s.len || s.len - i > 18) return false; // Cannot overflow
+    int64_t v = 0;
+    for (; i < s.len; i++) {
+        if (s.p[i] < '0' || s.p[i] > '9') return false;
+        v = v * 10 + (s.p[i] - '0');
+    }
+    out = neg ? -v : v;
+    return true;
+}
+
+// Strict decimal: optional '-', digits, optional '.' and digits; at least
+// one digit, no exponent, no inf/nan
+inline bool parseFloat(TextSpan s, float &out) {
+    size_t i = 0;
+    bool neg = s.len && s.p[0] == '-';
+    if (neg) i++;
+    if (s.len - i > 32) return false; // Stays finite as a float
+    double v = 0, scale = 1;
+    bool digits = false, point = false;
+    for (; i < s.len; i++) {
+        char c = s.p[i];
+        if (c == '.' && !point) {
+            point = true;
+        } else if (c >= '0' && c <= '9') {
+            digits = true;
+            if (point) {
+                scale *= 0.1;
+                v += (c - '0') * scale;
+            } else {
+                v = v * 10 + (c - '0');
+            }
+        } else {
+            return false;
+        }
+    }
+    if (!digits) return false;
+    out = (float)(neg ? -v : v);
+    return true;
+}
+
+#endif
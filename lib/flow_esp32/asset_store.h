@@ -0,0 +1,135 @@
+#ifndef ASSET_STORE_H
+#define ASSET_STORE_H
+
+#include <FS.h>
+#include <LittleFS.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ASSET_NAME_MAX 31              // Longest file name, without the leading '/'
+#define ASSET_UPLOAD_TEMP "/upload.tmp"
+
+// Dashboard files kept in the LittleFS partition, so the UI can be replaced
+// over HTTP without reflashing. Files are stored as uploaded, normally
+// gzipped: a request for /app.js is answered from app.js, or from
+// app.js.gz when only that exists, and "/" is index.html. The web server
+// streams them from flash a chunk at a time. Whatever is not in the store
+// is served from what is compiled into the firmware.
+// An upload is written to a temporary file that replaces the old one only
+// once complete, so an interrupted upload never leaves half a page behind.
+class AssetStore {
+public:
+    // Formats the partition when it holds no filesystem yet (first boot)
+    bool begin() {
+        _mounted = LittleFS.begin(true);
+        return _mounted;
+    }
+
+    bool mounted() const { return _mounted; }
+
+    // The file for a request path: `path` gets the name to hand to
+    // FlowWebServer::sendFile() (without .gz) and `etag` a validator made
+    // of the stored file's size and write time, which a new upload changes.
+    // False when neither form is stored.
+    bool find(const char *uri, char *path, size_t pathSize, bool &gzipped, char *etag, size_t etagSize) {
+        if (!_mounted) return false;
+        if (strcmp(uri, "/") == 0) uri = "/index.html";
+        if (!validName(uri + 1)) return false;
+        char stored[ASSET_NAME_MAX + 5];
+        snprintf(path, pathSize, "%s", uri);
+        snprintf(stored, sizeof(stored), "%s", uri);
+        gzipped = !LittleFS.exists(stored);
+        if (gzipped) {
+            snprintf(stored, sizeof(stored), "%s.gz", uri);
+            if (!LittleFS.exists(stored)) return false;
+        }
+        File file = LittleFS.open(stored, "r");
+        if (!file || file.isDirectory()) return false;
+        snprintf(etag, etagSize, "\"%x-%lx\"", (unsigned)file.size(), (unsigned long)file.getLastWrite());
+        file.close();
+        return true;
+    }
+
+    // Content type from the name without .gz
+    static const char *mimeType(const char *path) {
+        const char *ext = strrchr(path, '.');
+        if (!ext) return "application/octet-stream";
+        if (strcmp(ext, ".html") == 0) return "text/html";
+        if (strcmp(ext, ".js") == 0) return "application/javascript";
+        if (strcmp(ext, ".css") == 0) return "text/css";
+        if (strcmp(ext, ".json") == 0) return "application/json";
+        if (strcmp(ext, ".svg") == 0) return "image/svg+xml";
+        if (strcmp(ext, ".png") == 0) return "image/png";
+        if (strcmp(ext, ".ico") == 0) return "image/x-icon";
+        if (strcmp(ext, ".woff2") == 0) return "font/woff2";
+        return "application/octet-stream";
+    }
+
+    // A plain name in the root: letters, digits, '.', '-' and '_', not
+    // starting with '.'
+    static bool validName(const char *name) {
+        size_t len = strlen(name);
+        if (len == 0 || len > ASSET_NAME_MAX || name[0] == '.') return false;
+        for (size_t i = 0; i < len; i++) {
+            char c = name[i];
+            bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' ||
+                      c == '-' || c == '_';
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+    // Upload chunks (an UploadHandler): index 0 opens the temporary file,
+    // final moves it into place
+    void upload(const char *name, size_t index, const uint8_t *data, size_t len, bool final) {
+        if (index == 0) {
+            if (_file) _file.close(); // Left open by an upload that never finished
+            _uploadDone = false;
+            _uploadSize = 0;
+            _uploading = _mounted && validName(name);
+            if (!_uploading) return;
+            snprintf(_uploadName, sizeof(_uploadName), "/%s", name);
+            _file = LittleFS.open(ASSET_UPLOAD_TEMP, "w");
+            _uploading = (bool)_file;
+        }
+        if (!_uploading) return;
+        if (len && _file.write(data, len) != len) { // Partition full
+            _file.close();
+            LittleFS.remove(ASSET_UPLOAD_TEMP);
+            _uploading = false;
+            return;
+        }
+        _uploadSize += len;
+        if (!final) return;
+        _file.close();
+        _uploading = false;
+        if (LittleFS.exists(_uploadName)) LittleFS.remove(_uploadName);
+        _uploadDone = LittleFS.rename(ASSET_UPLOAD_TEMP, _uploadName);
+    }
+
+    // Whether a file was stored since the last call, and which
+    bool takeUpload(const char *&name, size_t &size) {
+        bool done = _uploadDone;
+        _uploadDone = false;
+        name = _uploadName + 1;
+        size = _uploadSize;
+        return done;
+    }
+
+    bool remove(const char *name) {
+        if (!_mounted || !validName(name)) return false;
+        char path[ASSET_NAME_MAX + 2];
+        snprintf(path, sizeof(path), "/%s", name);
+        return LittleFS.exists(path) && LittleFS.remove(path);
+    }
+
+private:
+    bool _mounted = false;
+    File _file;
+    bool _uploading = false;
+    bool _uploadDone = false;
+    char _uploadName[ASSET_NAME_MAX + 2] = "/";
+    size_t _uploadSize = 0;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef BATCH_CUTOFF_H
+#define BATCH_CUTOFF_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <atomic>
+
+// Sub-sample precise batch cutoff.
+// While a batch runs, the control task predicts from the filtered flow when
+// the target will be crossed. Once that instant (less the learned
+// relay/valve actuation latency) falls before the next tick, a one-shot
+// esp_timer is armed to drop the relay at exactly that time instead of on
+// the first tick after the crossing.
+// After the cut the volume keeps integrating for a settle window. The
+// overshoot past the target feeds the per-batch statistics; the latency
+// is learned from what still flowed between the relay drop and the end of
+// the window, measured on the unfiltered volume (raw ADC flow or pulse
+// count) so the Kalman filter's decay tail is not taken for valve lag.
+// esp_timer_stop() cannot stop a callback that is already running, so each
+// arm gets an epoch and every disarm moves the epoch on; the callback acts
+// only if its arm is still current, checked under the same lock, so a
+// pause or reset racing the timer can never have the relay dropped or the
+// batch marked done afterwards.
+#define CUTOFF_SETTLE_MS 3000
+#define CUTOFF_MAX_LATENCY_US 2000000
+#define CUTOFF_LEARN_RATE 0.5f
+#define CUTOFF_MIN_LEARN_FLOW 0.5f // L/min; below this the run-on says nothing about latency
+
+class BatchCutoff {
+public:
+    struct Stats {
+        uint32_t batches;
+        float lastOvershootL;
+        float meanOvershootL;
+        float maxOvershootL;  // Largest magnitude seen
+        uint32_t latencyUs;   // Current actuation latency estimate
+    };
+
+    bool begin(uint8_t relayPin, uint32_t latencyUs) {
+        _pin = relayPin;
+        _stats.latencyUs = latencyUs > CUTOFF_MAX_LATENCY_US ? 0 : latencyUs;
+
+        esp_timer_create_args_t args = {};
+        args.callback = &BatchCutoff::onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "batch_cutoff";
+        return esp_timer_create(&args, &_timer) == ESP_OK;
+    }
+
+    // Called every tick while the batch runs and the target is not yet met
+    void plan(int64_t volumeUl, int64_t targetUl, float flowLpm, uint32_t periodUs) {
+        if (flowLpm <= 0) {
+            disarm();
+            return;
+        }
+        // flow [L/min] / 60 = flow [uL/us]
+        int64_t crossUs = (int64_t)((targetUl - volumeUl) * 60.0f / flowLpm);
+        int64_t fireUs = crossUs - _stats.latencyUs;
+        if (fireUs >= periodUs) {
+            disarm(); // Next tick re-plans with a fresher flow value
+            return;
+        }
+        if (fireUs <= 0) {
+            trip();
+            return;
+        }
+        esp_timer_stop(_timer);
+        portENTER_CRITICAL(&_mux);
+        _armedEpoch = ++_epoch;
+        portEXIT_CRITICAL(&_mux);
+        if (esp_timer_start_once(_timer, fireUs) != ESP_OK) disarm();
+    }
+
+    // Drops the relay immediately
+    void trip() {
+        disarm();
+        digitalWrite(_pin, LOW);
+        _cutUs = esp_timer_get_time();
+        _fired = true;
+    }
+
+    bool fired() const { return _fired; }
+
+    // Target reached: stop any pending timer and open the settle window.
+    // rawUl is the unfiltered volume total now, up to a tick after the
+    // drop; the flow until then is taken as still at flowLpm.
+    void finish(int64_t targetUl, float flowLpm, int64_t rawUl) {
+        disarm();
+        _fired = false;
+        _settling = true;
+        _settleStartMs = millis();
+        _targetUl = targetUl;
+        _flowAtCut = flowLpm;
+        int64_t sinceCutUs = esp_timer_get_time() - _cutUs;
+        if (sinceCutUs < 0) sinceCutUs = 0;
+        _rawAtCutUl = rawUl - (int64_t)(flowLpm * sinceCutUs / 60.0f);
+    }
+
+    bool settling() const { return _settling; }
+
+    // Returns true once the settle window closes and the stats are updated
+    bool settle(int64_t volumeUl, int64_t rawUl) {
+        if (!_settling || millis() - _settleStartMs < CUTOFF_SETTLE_MS) return false;
+        _settling = false;
+
+        float overshootL = (volumeUl - _targetUl) * 1e-6f;
+        if (_flowAtCut >= CUTOFF_MIN_LEARN_FLOW) {
+            // Run-on after the drop, as time at the flow the cut was planned with
+            float measuredUs = (rawUl - _rawAtCutUl) * 60.0f / _flowAtCut;
+            float latency = _stats.latencyUs + CUTOFF_LEARN_RATE * (measuredUs - _stats.latencyUs);
+            if (latency < 0) latency = 0;
+            if (latency > CUTOFF_MAX_LATENCY_US) latency = CUTOFF_MAX_LATENCY_US;
+            _stats.latencyUs = (uint32_t)latency;
+        }
+
+        _stats.batches++;
+        _stats.lastOvershootL = overshootL;
+        _stats.meanOvershootL += (overshootL - _stats.meanOvershootL) / _stats.batches;
+        if (fabsf(overshootL) > fabsf(_stats.maxOvershootL)) _stats.maxOvershootL = overshootL;
+        return true;
+    }
+
+    // Pause, reset or restart: forget any pending cut and settle window
+    void cancel() {
+        disarm();
+        _fired = false;
+        _settling = false;
+    }
+
+    const Stats &stats() const { return _stats; }
+
+private:
+    static void onTimer(void *arg) {
+        BatchCutoff *self = static_cast<BatchCutoff *>(arg);
+        portENTER_CRITICAL(&self->_mux);
+        if (self->_armedEpoch == self->_epoch) {
+            digitalWrite(self->_pin, LOW);
+            self->_cutUs = esp_timer_get_time();
+            self->_fired = true;
+            self->_epoch++;
+        }
+        portEXIT_CRITICAL(&self->_mux);
+    }
+
+    // Once this returns no callback can act, even one already running
+    void disarm() {
+        portENTER_CRITICAL(&_mux);
+        bool armed = _armedEpoch == _epoch;
+        _epoch++;
+        portEXIT_CRITICAL(&_mux);
+        if (armed) esp_timer_stop(_timer);
+    }
+
+    esp_timer_handle_t _timer = nullptr;
+    uint8_t _pin = 0;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t _epoch = 1;      // Moves on at every arm and disarm
+    uint32_t _armedEpoch = 0; // Epoch of the pending arm; armed while equal
+    std::atomic<bool> _fired{false};
+    int64_t _cutUs = 0;       // When the relay dropped; published by _fired
+    bool _settling = false;
+    unsigned long _settleStartMs = 0;
+    int64_t _targetUl = 0;
+    float _flowAtCut = 0;
+    int64_t _rawAtCutUl = 0;  // Unfiltered volume total at the drop
+    Stats _stats = {};
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef FLOW_CHANNELS_H
+#define FLOW_CHANNELS_H
+
+#include <Arduino.h>
+#include "kalman_filter.h"
+#include "flow_totalizer.h"
+
+// Multi-line metering state, stored struct-of-arrays.
+// One control task scans every channel per tick. Each field lives in its
+// own contiguous array, so every pass over the bank (filter, integrate,
+// target check) walks consecutive words, and the pump states pack into a
+// bitmask that is tested, published and compared as a single byte.
+// Every channel runs an independent batch: own target, own volume, own
+// pump, cut on the first tick at or past its target.
+#define FLOW_MAX_CHANNELS 8
+
+template <uint8_t N>
+class FlowChannels {
+    static_assert(N >= 1 && N <= FLOW_MAX_CHANNELS, "1..8 channels supported");
+
+public:
+    // All lines share the filter tuning, so they share the steady-state gain
+    static constexpr float FILTER_GAIN = kalmanSteadyGain(0.01, 0.1);
+
+    void begin(const uint8_t *relayPins) {
+        for (uint8_t i = 0; i < N; i++) {
+            _relayPins[i] = relayPins[i];
+            _targetUl[i] = FlowTotalizer::fromLitres(1000.0f);
+            pinMode(_relayPins[i], OUTPUT);
+            digitalWrite(_relayPins[i], LOW);
+        }
+    }
+
+    // Filters the calibrated inputs (L/min), integrates running channels and
+    // cuts those that reached their target. Returns the mask of channels
+    // that finished on this tick.
+    uint8_t update(const float *flowIn, uint32_t dtUs) {
+        for (uint8_t i = 0; i < N; i++) _flow[i] += FILTER_GAIN * (flowIn[i] - _flow[i]);
+
+        for (uint8_t i = 0; i < N; i++) {
+            int32_t mlpm = FlowTotalizer::toMilliLpm(_flow[i]);
+            if (_relayMask & (1u << i)) {
+                FlowTotalizer::integrate(_volumeUl[i], _remainder[i], _lastMlpm[i], mlpm, dtUs);
+                _runUs[i] += dtUs;
+            }
+            _lastMlpm[i] = mlpm;
+        }
+
+        uint8_t done = 0;
+        for (uint8_t i = 0; i < N; i++) {
+            if ((_relayMask & (1u << i)) && _volumeUl[i] >= _targetUl[i]) done |= 1u << i;
+        }
+        if (done) {
+            for (uint8_t i = 0; i < N; i++) {
+                if (done & (1u << i)) digitalWrite(_relayPins[i], LOW);
+            }
+            _relayMask &= ~done;
+            _reachedMask |= done;
+        }
+        return done;
+    }
+
+    // Starting a channel whose batch completed begins a new one
+    bool setRelay(uint8_t ch, bool on) {
+        if (ch >= N) return false;
+        uint8_t bit = 1u << ch;
+        if (on && (_reachedMask & bit)) {
+            clear(ch);
+            _reachedMask &= ~bit;
+        }
+        if (on) _relayMask |= bit;
+        else _relayMask &= ~bit;
+        digitalWrite(_relayPins[ch], on ? HIGH : LOW);
+        return true;
+    }
+
+    // Same safety rules as the single-line controller: not while running,
+    // and never at or below the volume already delivered
+    bool setTarget(uint8_t ch, float litres) {
+        if (ch >= N || (_relayMask & (1u << ch))) return false;
+        int64_t targetUl = FlowTotalizer::fromLitres(litres);
+        if (targetUl <= _volumeUl[ch]) return false;
+        _targetUl[ch] = targetUl;
+        _reachedMask &= ~(1u << ch);
+        return true;
+    }
+
+    bool reset(uint8_t ch) {
+        if (ch >= N || (_relayMask & (1u << ch))) return false;
+        clear(ch);
+        _reachedMask &= ~(1u << ch);
+        return true;
+    }
+
+    void setVolume(uint8_t ch, int64_t microLitres) {
+        if (ch >= N) return;
+        _volumeUl[ch] = microLitres;
+        _remainder[ch] = 0;
+    }
+
+    float flow(uint8_t ch) const { return _flow[ch]; }
+    int64_t volumeUl(uint8_t ch) const { return _volumeUl[ch]; }
+    int64_t targetUl(uint8_t ch) const { return _targetUl[ch]; }
+    uint32_t runMs(uint8_t ch) const { return (uint32_t)(_runUs[ch] / 1000); }
+    uint8_t relayMask() const { return _relayMask; }
+    uint8_t reachedMask() const { return _reachedMask; }
+
+private:
+    void clear(uint8_t ch) {
+        _volumeUl[ch] = 0;
+        _remainder[ch] = 0;
+        _runUs[ch] = 0;
+    }
+
+    float _flow[N] = {};        // Filtered L/min
+    int32_t _lastMlpm[N] = {};  // Previous sample for the trapezoid
+    int64_t _volumeUl[N] = {};
+    int64_t _remainder[N] = {}; // Integration carry, see FlowTotalizer
+    int64_t _targetUl[N] = {};
+    uint64_t _runUs[N] = {};    // Pump-on time of the current batch
+    uint8_t _relayPins[N] = {};
+    uint8_t _relayMask = 0;     // Bit i: pump i on
+    uint8_t _reachedMask = 0;   // Bit i: batch i completed
+};
+
+template <uint8_t N> constexpr float FlowChannels<N>::FILTER_GAIN;
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef FLOW_PULSE_H
+#define FLOW_PULSE_H
+
+#include <Arduino.h>
+#include <driver/pcnt.h>
+
+// Hardware pulse counting for pulse-output (turbine) flow meters.
+// A PCNT unit counts rising edges on its own, behind the glitch filter,
+// so the CPU only runs once per control tick to read the counter and once
+// every PULSE_COUNTER_LIMIT edges for the overflow interrupt, regardless
+// of the meter's pulse rate.
+// Volume comes straight from the edge count and the meter's K-factor
+// (pulses per litre) with an integer remainder carried between reads, so
+// it is exact; flow is counts per tick interval.
+#define PULSE_COUNTER_LIMIT 30000 // Hardware counter is int16; wraps to 0 here
+#define PULSE_FILTER_MAX_CYCLES 1023 // 10-bit filter, APB (80 MHz) cycles
+
+class PulseCounter {
+public:
+    // kFactor: pulses per litre. filterNs: edges shorter than this are
+    // ignored (up to ~12.7 us).
+    bool begin(uint8_t pin, float kFactor, uint32_t filterNs, pcnt_unit_t unit = PCNT_UNIT_0) {
+        if (kFactor <= 0) return false;
+        _unit = unit;
+        _kMilli = (int64_t)(kFactor * 1000.0f + 0.5f);
+
+        pcnt_config_t config = {};
+        config.pulse_gpio_num = pin;
+        config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+        config.channel = PCNT_CHANNEL_0;
+        config.unit = unit;
+        config.pos_mode = PCNT_COUNT_INC;
+        config.neg_mode = PCNT_COUNT_DIS;
+        config.lctrl_mode = PCNT_MODE_KEEP;
+        config.hctrl_mode = PCNT_MODE_KEEP;
+        config.counter_h_lim = PULSE_COUNTER_LIMIT;
+        config.counter_l_lim = 0;
+        if (pcnt_unit_config(&config) != ESP_OK) return false;
+
+        uint32_t cycles = (uint32_t)((uint64_t)filterNs * APB_CLK_FREQ / 1000000000ULL);
+        if (cycles > PULSE_FILTER_MAX_CYCLES) cycles = PULSE_FILTER_MAX_CYCLES;
+        pcnt_set_filter_value(unit, cycles);
+        if (cycles > 0) pcnt_filter_enable(unit);
+        else pcnt_filter_disable(unit);
+
+        pcnt_event_enable(unit, PCNT_EVT_H_LIM);
+        esp_err_t err = pcnt_isr_service_install(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return false; // Already installed is fine
+        if (pcnt_isr_handler_add(unit, &PulseCounter::onLimit, this) != ESP_OK) return false;
+
+        pcnt_counter_pause(unit);
+        pcnt_counter_clear(unit);
+        pcnt_counter_resume(unit);
+        return true;
+    }
+
+    // Edges since boot. Must be called at least once per PULSE_COUNTER_LIMIT
+    // edges (e.g. every 100 ms up to 300 kHz).
+    uint64_t total() {
+        int16_t count = 0;
+        portENTER_CRITICAL(&_mux);
+        pcnt_get_counter_value(_unit, &count);
+        uint64_t total = _overflow + (uint16_t)count;
+        portEXIT_CRITICAL(&_mux);
+        // The counter wrapped but the limit interrupt has not run yet
+        if (total < _lastTotal) total += PULSE_COUNTER_LIMIT;
+        _lastTotal = total;
+        return total;
+    }
+
+    // Edges since the previous call
+    uint32_t sample() {
+        uint64_t now = total();
+        uint32_t delta = (uint32_t)(now - _lastSample);
+        _lastSample = now;
+        return delta;
+    }
+
+    // Exact volume of a count, with the sub-micro-litre part carried over
+    int64_t toMicroLitres(uint32_t counts) {
+        // counts / (kMilli / 1000) [L] = counts * 1e9 / kMilli [uL]
+        int64_t num = (int64_t)counts * 1000000000LL + _remainder;
+        _remainder = num % _kMilli;
+        return num / _kMilli;
+    }
+
+    float flowLpm(uint32_t counts, uint32_t dtUs) const {
+        if (dtUs == 0) return 0;
+        // counts / K [L] over dt [us] -> L/min
+        return counts * 60.0e6f * 1000.0f / ((float)_kMilli * dtUs);
+    }
+
+    float kFactor() const { return _kMilli / 1000.0f; }
+
+private:
+    static void IRAM_ATTR onLimit(void *arg) {
+        PulseCounter *self = static_cast<PulseCounter *>(arg);
+        portENTER_CRITICAL_ISR(&self->_mux);
+        self->_overflow += PULSE_COUNTER_LIMIT;
+        portEXIT_CRITICAL_ISR(&self->_mux);
+    }
+
+    pcnt_unit_t _unit = PCNT_UNIT_0;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+    volatile uint64_t _overflow = 0;
+    uint64_t _lastTotal = 0;
+    uint64_t _lastSample = 0;
+    int64_t _kMilli = 1000; // Pulses per 1000 L
+    int64_t _remainder = 0;
+};
+
+#endif
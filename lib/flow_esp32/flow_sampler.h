@@ -0,0 +1,116 @@
+#ifndef FLOW_SAMPLER_H
+#define FLOW_SAMPLER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// Deterministic sample clock for the flow control task.
+// A periodic esp_timer stamps every tick with esp_timer_get_time() (1 us
+// resolution) and wakes the consumer task through its notification slot,
+// so the integrator gets the real dt between samples instead of whatever
+// vTaskDelay() + millis() happened to produce.
+#define SAMPLER_MIN_RATE_HZ 10
+#define SAMPLER_MAX_RATE_HZ 1000
+
+class FlowSampler {
+public:
+    struct Stats {
+        uint32_t samples;       // Ticks consumed since last reset
+        uint32_t missed;        // Ticks that fired before the consumer caught up
+        uint32_t nominalUs;     // Configured period
+        int32_t minPeriodUs;    // Shortest measured period
+        int32_t maxPeriodUs;    // Longest measured period
+        float jitterRmsUs;      // RMS deviation from the nominal period
+    };
+
+    bool begin(uint32_t rateHz, TaskHandle_t consumer) {
+        if (rateHz < SAMPLER_MIN_RATE_HZ) rateHz = SAMPLER_MIN_RATE_HZ;
+        if (rateHz > SAMPLER_MAX_RATE_HZ) rateHz = SAMPLER_MAX_RATE_HZ;
+        _periodUs = 1000000UL / rateHz;
+        _consumer = consumer;
+
+        esp_timer_create_args_t args = {};
+        args.callback = &FlowSampler::onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "flow_sampler";
+        if (esp_timer_create(&args, &_timer) != ESP_OK) return false;
+
+        resetStats();
+        _lastUs = esp_timer_get_time();
+        return esp_timer_start_periodic(_timer, _periodUs) == ESP_OK;
+    }
+
+    uint32_t periodUs() const { return _periodUs; }
+
+    // Blocks until the next tick. Returns the tick timestamp and the exact
+    // time elapsed since the previous consumed tick, both in microseconds.
+    bool wait(int64_t &timestampUs, uint32_t &dtUs, TickType_t timeout) {
+        uint32_t ticks = ulTaskNotifyTake(pdTRUE, timeout);
+        if (ticks == 0) return false;
+
+        portENTER_CRITICAL(&_mux);
+        timestampUs = _tickUs;
+        portEXIT_CRITICAL(&_mux);
+
+        int64_t delta = timestampUs - _lastUs;
+        _lastUs = timestampUs;
+        dtUs = (uint32_t)delta;
+
+        // Missed ticks still produce an exact dt; only the jitter figure
+        // is normalised by the number of periods that elapsed.
+        int32_t error = (int32_t)(delta - (int64_t)_periodUs * ticks);
+        int32_t period = (int32_t)(delta / ticks);
+
+        portENTER_CRITICAL(&_mux);
+        _stats.samples++;
+        _stats.missed += ticks - 1;
+        if (period < _stats.minPeriodUs) _stats.minPeriodUs = period;
+        if (period > _stats.maxPeriodUs) _stats.maxPeriodUs = period;
+        _sumSqError += (double)error * error;
+        portEXIT_CRITICAL(&_mux);
+        return true;
+    }
+
+    Stats stats() {
+        portENTER_CRITICAL(&_mux);
+        Stats s = _stats;
+        double sumSq = _sumSqError;
+        portEXIT_CRITICAL(&_mux);
+        s.jitterRmsUs = s.samples ? sqrt(sumSq / s.samples) : 0;
+        return s;
+    }
+
+    void resetStats() {
+        portENTER_CRITICAL(&_mux);
+        _stats.samples = 0;
+        _stats.missed = 0;
+        _stats.nominalUs = _periodUs;
+        _stats.minPeriodUs = INT32_MAX;
+        _stats.maxPeriodUs = 0;
+        _stats.jitterRmsUs = 0;
+        _sumSqError = 0;
+        portEXIT_CRITICAL(&_mux);
+    }
+
+private:
+    static void onTimer(void *arg) {
+        FlowSampler *self = static_cast<FlowSampler *>(arg);
+        int64_t now = esp_timer_get_time();
+        portENTER_CRITICAL(&self->_mux);
+        self->_tickUs = now;
+        portEXIT_CRITICAL(&self->_mux);
+        xTaskNotifyGive(self->_consumer);
+    }
+
+    esp_timer_handle_t _timer = nullptr;
+    TaskHandle_t _consumer = nullptr;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t _periodUs = 100000;
+    int64_t _tickUs = 0;
+    int64_t _lastUs = 0;
+    double _sumSqError = 0;
+    Stats _stats = {};
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+// Web transport, chosen at build time:
+// 0: polled WebServer on port 80 and WebSocketsServer on port 81, both
+//    pumped from loop()
+// 1: callback-driven ESPAsyncWebServer; page and WebSocket (/ws) share
+//    port 80 and requests are answered from the TCP stack's task
+#ifndef WEB_SERVER_ASYNC
+#define WEB_SERVER_ASYNC 0
+#endif
+
+#include <FS.h>
+
+// Upload chunks as they arrive: index 0 starts a file, final ends it
+typedef void (*UploadHandler)(const char *name, size_t index, const uint8_t *data, size_t len, bool final);
+
+#if WEB_SERVER_ASYNC
+#include <ESPAsyncWebServer.h>
+
+#define HTTP_RESPONSE_HEADERS_MAX 6
+
+// The part of WebServer the sketch's handlers use, over ESPAsyncWebServer,
+// so the same handlers serve either transport. The library runs handlers
+// one at a time on its TCP task; the request in hand and the headers set
+// for its response are held here until send() builds the response. Header
+// names and values must outlive the handler (literals and constants).
+class FlowWebServer {
+public:
+    typedef void (*Handler)();
+
+    explicit FlowWebServer(uint16_t port) : _server(port) {}
+
+    AsyncWebServer &async() { return _server; }
+
+    void on(const char *uri, Handler handler) { on(uri, HTTP_GET, handler); }
+
+    void on(const char *uri, WebRequestMethod method, Handler handler) {
+        _server.on(uri, method, [this, handler](AsyncWebServerRequest *request) { run(request, handler); });
+    }
+
+    void onNotFound(Handler handler) {
+        _server.onNotFound([this, handler](AsyncWebServerRequest *request) { run(request, handler); });
+    }
+
+    // POST with a multipart file; `done` answers once the body is in. The
+    // request is in hand during `chunk` too, for authenticate().
+    void onUpload(const char *uri, Handler done, UploadHandler chunk) {
+        _server.on(uri, HTTP_POST, [this, done](AsyncWebServerRequest *request) { run(request, done); },
+                   [this, chunk](AsyncWebServerRequest *request, const String &name, size_t index, uint8_t *data,
+                                 size_t len, bool final) {
+                       _request = request;
+                       chunk(name.c_str(), index, data, len, final);
+                       _request = nullptr;
+                   });
+    }
+
+    void collectHeaders(const char **, size_t) {} // Every request header is kept
+    void begin() { _server.begin(); }
+    void handleClient() {} // Nothing to poll
+
+    String header(const char *name) const {
+        const AsyncWebHeader *h = _request ? _request->getHeader(name) : nullptr;
+        return h ? h->value() : String();
+    }
+
+    String arg(const char *name) const { return _request ? _request->arg(name) : String(); }
+
+    // HTTP authentication, as WebServer::authenticate()
+    bool authenticate(const char *user, const char *password) {
+        return _request && _request->authenticate(user, password);
+    }
+
+    void requestAuthentication() {
+        _request->requestAuthentication();
+        _request = nullptr;
+    }
+    String uri() const { return _request ? _request->url() : String(); }
+
+    void sendHeader(const char *name, const char *value) {
+        if (_headerCount < HTTP_RESPONSE_HEADERS_MAX) _headers[_headerCount++] = {name, value};
+    }
+
+    void send(int code, const char *type = "text/plain", const char *content = "") {
+        finish(_request->beginResponse(code, type, content));
+    }
+
+    void send_P(int code, const char *type, PGM_P content, size_t len) {
+        finish(_request->beginResponse(code, type, (const uint8_t *)content, len));
+    }
+
+    void send_P(int code, const char *type, PGM_P content) { send_P(code, type, content, strlen_P(content)); }
+
+    // `path`, or `path`.gz sent with Content-Encoding: gzip when only that
+    // exists, streamed from flash in chunks
+    void sendFile(fs::FS &fs, const char *path, const char *type) { finish(_request->beginResponse(fs, path, type)); }
+
+private:
+    struct Header {
+        const char *name;
+        const char *value;
+    };
+
+    void run(AsyncWebServerRequest *request, Handler handler) {
+        _request = request;
+        _headerCount = 0;
+        handler();
+        if (_request) send(500); // The handler sent nothing
+    }
+
+    void finish(AsyncWebServerResponse *response) {
+        for (uint8_t i = 0; i < _headerCount; i++) response->addHeader(_headers[i].name, _headers[i].value);
+        _request->send(response);
+        _request = nullptr;
+    }
+
+    AsyncWebServer _server;
+    AsyncWebServerRequest *_request = nullptr;
+    Header _headers[HTTP_RESPONSE_HEADERS_MAX];
+    uint8_t _headerCount = 0;
+};
+#else
+#include <WebServer.h>
+
+// WebServer with the additions the async variant has
+class FlowWebServer : public WebServer {
+public:
+    explicit FlowWebServer(uint16_t port) : WebServer(port) {}
+
+    // POST with a multipart file; `done` answers once the body is in
+    void onUpload(const char *uri, THandlerFunction done, UploadHandler chunk) {
+        on(uri, HTTP_POST, done, [this, chunk]() {
+            HTTPUpload &u = upload();
+            if (u.status == UPLOAD_FILE_START) {
+                _uploadIndex = 0;
+            } else if (u.status == UPLOAD_FILE_WRITE) {
+                chunk(u.filename.c_str(), _uploadIndex, u.buf, u.currentSize, false);
+                _uploadIndex += u.currentSize;
+            } else if (u.status == UPLOAD_FILE_END) {
+                chunk(u.filename.c_str(), _uploadIndex, nullptr, 0, true);
+            }
+        });
+    }
+
+    // `path`, or `path`.gz sent with Content-Encoding: gzip when only that
+    // exists, streamed from flash in chunks
+    void sendFile(fs::FS &fs, const char *path, const char *type) {
+        String name = path;
+        if (!fs.exists(name)) name += ".gz";
+        File file = fs.open(name, "r");
+        if (!file) {
+            send(404, "text/plain", "Not Found");
+            return;
+        }
+        streamFile(file, type); // Adds Content-Encoding for .gz
+        file.close();
+    }
+
+private:
+    size_t _uploadIndex = 0;
+};
+#endif
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef WS_SERVER_H
+#define WS_SERVER_H
+
+#include "http_server.h"
+
+#if WEB_SERVER_ASYNC
+#include <string.h>
+#include "spsc_ring.h"
+
+#define WEBSOCKETS_SERVER_CLIENT_MAX 5
+#define WS_FRAGMENT_MAX 0xFFFF   // Whole messages: the library copies and queues them itself
+#define WS_EVENT_TEXT_MAX 512    // Longest text message taken; command frames are far shorter
+#define WS_EVENT_QUEUE 8
+
+// The event types of the polled server that the sketch handles
+typedef enum { WStype_DISCONNECTED, WStype_CONNECTED, WStype_TEXT } WStype_t;
+
+// The WebSocket at /ws on the async HTTP server, with the interface of the
+// polled server below, so the sketch does not change with the transport.
+// The library calls back from its TCP task; connects, disconnects and text
+// messages are copied into a ring there and handed to the sketch from
+// loop(), so the handler and everything it touches stay on one thread, as
+// with the polled server. Clients get the same slot numbers, 0 to
+// WEBSOCKETS_SERVER_CLIENT_MAX - 1; a client that finds no free slot is
+// closed.
+class FlowWebSocketsServer {
+public:
+    typedef void (*EventHandler)(uint8_t num, WStype_t type, uint8_t *payload, size_t length);
+
+    FlowWebSocketsServer(AsyncWebServer &server, const char *path) : _server(server), _ws(path) {}
+
+    void begin() {
+        _ws.onEvent([this](AsyncWebSocket *, AsyncWebSocketClient *client, AwsEventType type, void *arg,
+                           uint8_t *data, size_t len) { queueEvent(client, type, arg, data, len); });
+        _server.addHandler(&_ws);
+    }
+
+    void onEvent(EventHandler handler) { _handler = handler; }
+
+    // Hands the queued events to the handler; a client that went away
+    // without an event (ring full) is noticed here too
+    void loop() {
+        Event ev;
+        while (_events.pop(ev)) dispatch(ev);
+        for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+            if (_ids[num] && !clientIsConnected(num)) closed(num);
+        }
+        _ws.cleanupClients(WEBSOCKETS_SERVER_CLIENT_MAX);
+    }
+
+    bool clientIsConnected(uint8_t num) {
+        AsyncWebSocketClient *c = client(num);
+        return c && c->status() == WS_CONNECTED;
+    }
+
+    // Room in the library's queue for this client, which it empties as the
+    // TCP stack acknowledges data
+    bool writable(uint8_t num) {
+        AsyncWebSocketClient *c = client(num);
+        return c && c->canSend();
+    }
+
+    bool sendTXT(uint8_t num, const uint8_t *data, size_t len) {
+        AsyncWebSocketClient *c = client(num);
+        return c && c->text((const char *)data, len);
+    }
+
+    bool sendBIN(uint8_t num, const uint8_t *data, size_t len) {
+        AsyncWebSocketClient *c = client(num);
+        return c && c->binary(data, len);
+    }
+
+    // Only whole messages (WS_FRAGMENT_MAX)
+    bool sendFragment(uint8_t num, const uint8_t *data, size_t len, bool first, bool last) {
+        return first && last && sendBIN(num, data, len);
+    }
+
+    // The handler hears of it as WStype_DISCONNECTED from a later loop()
+    void disconnect(uint8_t num) {
+        AsyncWebSocketClient *c = client(num);
+        if (c) c->close();
+    }
+
+    uint32_t droppedEvents() const { return _events.dropped(); }
+
+private:
+    struct Event {
+        uint32_t id;
+        WStype_t type;
+        uint16_t len;
+        char text[WS_EVENT_TEXT_MAX + 1];
+    };
+
+    AsyncWebSocketClient *client(uint8_t num) {
+        return num < WEBSOCKETS_SERVER_CLIENT_MAX && _ids[num] ? _ws.client(_ids[num]) : nullptr;
+    }
+
+    // Slot holding a library client id; id 0 finds a free slot
+    int8_t slotOf(uint32_t id) const {
+        for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+            if (_ids[num] == id) return num;
+        }
+        return -1;
+    }
+
+    // TCP task
+    void queueEvent(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+        Event ev;
+        ev.id = client->id();
+        ev.len = 0;
+        if (type == WS_EVT_CONNECT) {
+            ev.type = WStype_CONNECTED;
+        } else if (type == WS_EVT_DISCONNECT) {
+            ev.type = WStype_DISCONNECTED;
+        } else if (type == WS_EVT_DATA) {
+            // Single-frame text messages, which is all a client sends here
+            const AwsFrameInfo *info = (const AwsFrameInfo *)arg;
+            if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) return;
+            if (len > WS_EVENT_TEXT_MAX) return;
+            ev.type = WStype_TEXT;
+            ev.len = len;
+            memcpy(ev.text, data, len);
+            ev.text[len] = '\0';
+        } else {
+            return;
+        }
+        _events.push(ev);
+    }
+
+    // loop()
+    void dispatch(Event &ev) {
+        int8_t num = slotOf(ev.type == WStype_CONNECTED ? 0 : ev.id);
+        if (num < 0) {
+            if (ev.type == WStype_CONNECTED) {
+                AsyncWebSocketClient *c = _ws.client(ev.id);
+                if (c) c->close(); // No free slot
+            }
+            return;
+        }
+        if (ev.type == WStype_CONNECTED) _ids[num] = ev.id;
+        if (ev.type == WStype_DISCONNECTED) closed(num);
+        else if (_handler) _handler(num, ev.type, (uint8_t *)ev.text, ev.len);
+    }
+
+    void closed(uint8_t num) {
+        _ids[num] = 0;
+        if (_handler) _handler(num, WStype_DISCONNECTED, nullptr, 0);
+    }
+
+    AsyncWebServer &_server;
+    AsyncWebSocket _ws;
+    EventHandler _handler = nullptr;
+    uint32_t _ids[WEBSOCKETS_SERVER_CLIENT_MAX] = {}; // Library client id per slot; 0 = free
+    SpscRing<Event, WS_EVENT_QUEUE> _events;
+};
+#else
+#include <WiFi.h>
+#include <WebSocketsServer.h>
+#include <lwip/sockets.h>
+
+#define WS_FRAGMENT_MAX 1460 // One TCP segment; library writes this size need no heap copy
+
+// WebSocketsServer that can tell whether a client's socket has room.
+// Library writes block until the data is in the TCP send buffer, for
+// seconds on a congested link; checking first with a zero-timeout
+// select() lets loop() skip that client and come back later.
+// Large binary messages go out as WebSocket fragments, one per call, so
+// they can be written a socket's worth at a time in the same way.
+class FlowWebSocketsServer : public WebSocketsServer {
+public:
+    explicit FlowWebSocketsServer(uint16_t port) : WebSocketsServer(port) {}
+
+    bool writable(uint8_t num) {
+        if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !clientIsConnected(num) || !_clients[num].tcp) return false;
+        int fd = _clients[num].tcp->fd();
+        if (fd < 0) return false;
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(fd, &set);
+        struct timeval timeout = {0, 0};
+        return select(fd + 1, nullptr, &set, nullptr, &timeout) > 0;
+    }
+
+    // Part of a binary message, at most WS_FRAGMENT_MAX bytes. Nothing else
+    // may be sent to this client between the first fragment and the last.
+    bool sendFragment(uint8_t num, const uint8_t *data, size_t len, bool first, bool last) {
+        if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !clientIsConnected(num)) return false;
+        return sendFrame(&_clients[num], first ? WSop_binary : WSop_continuation, (uint8_t *)data, len, last);
+    }
+};
+#endif
+
+#endif
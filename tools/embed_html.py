@@ -0,0 +1,203 @@
+# PlatformIO pre-script shared by the sketches, run from each project's
+# platformio.ini with
+#   extra_scripts = pre:../tools/embed_html.py
+# It minifies and gzips the dashboard page in include/index_html.h into
+# include/index_html_gz.h (generated, not in git), which handleRoot()
+# serves with Content-Encoding: gzip. INDEX_HTML itself stays the source
+# and the uncompressed fallback. The header also carries ETags from a hash
+# of the page, so browsers revalidate with a 304.
+#
+# Minification is deliberately conservative: indentation, blank lines and
+# HTML/CSS comments go; line breaks stay, so JavaScript never depends on
+# them being removed correctly. gzip does the rest.
+#
+# Two steps are opt-in, per project, through custom options in its
+# platformio.ini:
+#
+#   custom_embed_bundle = yes
+#     Also writes the gzipped page to data/index.html.gz, the UI bundle
+#     for the LittleFS asset store: "pio run -t uploadfs" flashes it, or
+#     it is uploaded over HTTP to a running device (POST /assets, built in
+#     when ASSET_UPLOAD_PASSWORD is set).
+#
+#   custom_embed_font = <path to a .ttf, relative to the project>
+#     The dashboard font is served by the device, never fetched from the
+#     internet. The font (../fonts/Outfit.ttf, see fonts/README.md) is cut
+#     down to the glyphs the page can show and written to
+#     include/font_woff2.h as woff2; this needs fontTools and brotli
+#     (pip install fonttools brotli), and the build stops if the font or
+#     either module is missing. Without the option the page renders in
+#     the system font.
+#
+# Also runs standalone: python tools/embed_html.py [project_dir]
+import gzip
+import hashlib
+import io
+import os
+import re
+import sys
+from configparser import ConfigParser
+
+SOURCE = os.path.join("include", "index_html.h")
+TARGET = os.path.join("include", "index_html_gz.h")
+FONT_TARGET = os.path.join("include", "font_woff2.h")
+BUNDLE_TARGET = os.path.join("data", "index.html.gz")
+
+
+class EmbedError(Exception):
+    pass
+
+
+def page_text(header):
+    match = re.search(r'R"=====\((.*)\)====="', header, re.S)
+    if not match:
+        raise ValueError("no R\"=====(...)=====\" literal in " + SOURCE)
+    return match.group(1)
+
+
+def minify(html):
+    html = re.sub(r"<!--.*?-->", "", html, flags=re.S)
+    html = re.sub(r"/\*.*?\*/", "", html, flags=re.S)
+    lines = (line.strip() for line in html.splitlines())
+    return "\n".join(line for line in lines if line)
+
+
+def etag_of(data):
+    return hashlib.sha1(data).hexdigest()[:16]
+
+
+def c_array(name, data):
+    rows = []
+    for i in range(0, len(data), 16):
+        rows.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "const uint8_t %s[] PROGMEM = {\n%s\n};\nconst size_t %s_LEN = %u;\n" % (
+        name, "\n".join(rows), name, len(data))
+
+
+def c_header(guard, source, body):
+    return (
+        "// Generated by embed_html.py from %s. Do not edit.\n"
+        "#ifndef %s\n"
+        "#define %s\n\n"
+        "#include <stddef.h>\n"
+        "#include <stdint.h>\n\n"
+        "%s\n"
+        "#endif\n"
+    ) % (source, guard, guard, body)
+
+
+def write_if_changed(path, text):
+    if os.path.exists(path):
+        with open(path, encoding="utf-8") as f:
+            if f.read() == text:
+                return False  # Unchanged: no rebuild
+    with open(path, "w", encoding="utf-8") as f:
+        f.write(text)
+    return True
+
+
+def ini_option(project_dir, name):
+    # Standalone: the option from the first env that sets it, as the
+    # default env would see it through [env] or extends
+    config = ConfigParser(interpolation=None)
+    config.read(os.path.join(project_dir, "platformio.ini"), encoding="utf-8")
+    for section in config.sections():
+        if (section == "env" or section.startswith("env:")) and config.has_option(section, name):
+            return config.get(section, name)
+    return ""
+
+
+def enabled(value):
+    return value.strip().lower() in ("1", "yes", "true", "on")
+
+
+def write_bundle(project_dir, packed):
+    path = os.path.join(project_dir, BUNDLE_TARGET)
+    if os.path.exists(path):
+        with open(path, "rb") as f:
+            if f.read() == packed:
+                return
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "wb") as f:
+        f.write(packed)
+    print("embed_html: %s %u bytes" % (BUNDLE_TARGET, len(packed)))
+
+
+def embed_page(project_dir, page, bundle):
+    plain = page.encode("utf-8")
+    # mtime=0 keeps the output identical from build to build
+    packed = gzip.compress(minify(page).encode("utf-8"), 9, mtime=0)
+    etag = etag_of(plain)
+    body = (
+        "// %u bytes of page, minified and gzipped\n"
+        "%s\n"
+        "// Validators, one per encoding\n"
+        "#define INDEX_HTML_ETAG \"\\\"%s\\\"\"\n"
+        "#define INDEX_HTML_GZ_ETAG \"\\\"%s-gz\\\"\"\n"
+    ) % (len(plain), c_array("INDEX_HTML_GZ", packed), etag, etag)
+    if write_if_changed(os.path.join(project_dir, TARGET), c_header("INDEX_HTML_GZ_H", "index_html.h", body)):
+        print("embed_html: %s %u -> %u bytes gzipped" % (TARGET, len(plain), len(packed)))
+    if bundle:
+        write_bundle(project_dir, packed)
+
+
+def embed_font(project_dir, page, font):
+    target = os.path.join(project_dir, FONT_TARGET)
+    if not font:
+        if os.path.exists(target):
+            os.remove(target)  # Font taken out: stop serving the old one
+        return
+    # Asked for a font: a build without it would quietly fall back to the
+    # system font, so stop instead
+    source = os.path.normpath(os.path.join(project_dir, font))
+    if not os.path.exists(source):
+        raise EmbedError("custom_embed_font = %s: no such file (see fonts/README.md)" % font)
+    try:
+        import brotli  # noqa: F401 (woff2 compression)
+        from fontTools import subset
+    except ImportError:
+        raise EmbedError("custom_embed_font needs fontTools and brotli: pip install fonttools brotli")
+
+    # Every character the page source contains, plus printable ASCII for
+    # readings and messages built at run time
+    text = "".join(sorted(set(page) | set(chr(c) for c in range(0x20, 0x7f))))
+    options = subset.Options()
+    options.flavor = "woff2"
+    glyphs = subset.load_font(source, options)
+    subsetter = subset.Subsetter(options)
+    subsetter.populate(text=text)
+    subsetter.subset(glyphs)
+    out = io.BytesIO()
+    subset.save_font(glyphs, out, options)
+    data = out.getvalue()
+
+    body = (
+        "// Outfit, subsetted to the dashboard's glyphs, woff2 (already compressed)\n"
+        "%s\n"
+        "#define FONT_WOFF2_ETAG \"\\\"%s\\\"\"\n"
+    ) % (c_array("FONT_WOFF2", data), etag_of(data))
+    if write_if_changed(target, c_header("FONT_WOFF2_H", font.replace(os.sep, "/"), body)):
+        print("embed_html: %s %u -> %u bytes woff2" % (FONT_TARGET, os.path.getsize(source), len(data)))
+
+
+def embed(project_dir, option):
+    with open(os.path.join(project_dir, SOURCE), encoding="utf-8") as f:
+        page = page_text(f.read())
+    embed_page(project_dir, page, enabled(option("custom_embed_bundle")))
+    embed_font(project_dir, page, option("custom_embed_font").strip())
+
+
+try:
+    Import("env")  # noqa: F821 (PlatformIO SCons)
+except NameError:
+    project = sys.argv[1] if len(sys.argv) > 1 else os.getcwd()
+    try:
+        embed(project, lambda name: ini_option(project, name))
+    except EmbedError as e:
+        sys.exit("embed_html: error: %s" % e)
+else:
+    try:
+        embed(env.subst("$PROJECT_DIR"), lambda name: env.GetProjectOption(name, ""))  # noqa: F821
+    except EmbedError as e:
+        sys.stderr.write("embed_html: error: %s\n" % e)
+        env.Exit(1)  # noqa: F821